@@ -39,10 +39,12 @@ namespace dae
 #ifdef _UNICODE
 	#define TSTRING std::wstring
 	#define TCOUT std::wcout
+	#define TO_TSTRING std::to_wstring
 
 #else
 	#define TSTRING std::string
 	#define TCOUT std::cout
+	#define TO_TSTRING std::to_string
 
 #endif
 
@@ -20,6 +20,18 @@ namespace dae
 		Vector3 tangent{}; 
 	};
 
+	// structure of arrays copy of a vertex buffer, one stream per component
+	// streams are padded with zeroes to a multiple of SIMD::MaxBlockWidth vertices so SIMD loads never read past the end
+	struct VertexStreams
+	{
+		size_t count{};
+
+		std::vector<float> positionX{}, positionY{}, positionZ{};
+		std::vector<float> u{}, v{};
+		std::vector<float> normalX{}, normalY{}, normalZ{};
+		std::vector<float> tangentX{}, tangentY{}, tangentZ{};
+	};
+
 	struct Vertex_Out
 	{
 		Vector4 position{};
@@ -29,6 +41,15 @@ namespace dae
 		Vector3 viewDirection{};
 	};
 
+	// screenspace part of a Vertex_Out, computed once per vertex by the software vertex stage
+	struct Vertex_Screen
+	{
+		Vector2 position{};	// pixel coordinates
+		float depth{};	// z / w
+		float invW{};	// 1 / w
+		uint32_t outcode{};	// SIMD::ClipCode bits of the clip planes the vertex is outside of
+	};
+
 	struct Triangle
 	{
 		Vertex_Out v0{};
@@ -109,6 +130,22 @@ namespace dae
 		bool depthWrite{ true };
 	};
 
+	// matrices + optional outputs the software vertex stage output of a mesh was produced with
+	struct VertexCacheKey
+	{
+		Matrix world{};
+		Matrix view{};
+		Matrix projection{};
+		bool hasViewDirection{ false };
+		bool isValid{ false };
+
+		bool operator==(const VertexCacheKey& other) const
+		{
+			return isValid && other.isValid && hasViewDirection == other.hasViewDirection
+				&& world == other.world && view == other.view && projection == other.projection;
+		}
+	};
+
 	struct Mesh
 	{
 		virtual ~Mesh() = default;
@@ -117,7 +154,13 @@ namespace dae
 		std::vector<uint32_t> indices{};
 		PrimitiveTopology primitiveTopology{ PrimitiveTopology::TriangleList };
 
+		// software rasterizer only, vertices in SoA layout (built once) and after the vertex stage
+		// vertices created by clipping are appended to vertices_out/vertices_screen for the rest of the frame
+		VertexStreams vertices_soa{};
 		std::vector<Vertex_Out> vertices_out{};
+		std::vector<Vertex_Screen> vertices_screen{};
+		// vertices_out/vertices_screen stay valid across frames while this matches
+		VertexCacheKey vertices_outKey{};
 		Matrix worldMatrix{};
 
 		MaterialID materialId{};
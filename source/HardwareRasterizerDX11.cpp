@@ -60,12 +60,10 @@ namespace dae
 		//		  2. Set Pipeline	+ Invoke Drawcalls (= render)      //
 		//=============================================================//
 
-		for (const auto& pMesh : pScene->m_pMeshes)
+		m_RenderQueue.Build(*pScene);
+		for (const auto& drawItem : m_RenderQueue.GetDrawItems())
 		{
-			if (!pMesh->render)
-				continue;
-
-			RenderMesh(pMesh.get(), pScene->GetCamera());
+			RenderMesh(drawItem.pMesh, pScene->GetCamera());
 		}
 
 		//=============================================================//
@@ -77,16 +75,8 @@ namespace dae
 
 	void HardwareRasterizerDX11::KeyDownEvent(SDL_KeyboardEvent e)
 	{
+		//F4 (filter mode) is shared with the software rasterizer, see Renderer::KeyDownEvent
 		Renderer::KeyDownEvent(e);
-
-		switch (e.keysym.scancode)
-		{
-		case SDL_SCANCODE_F4:
-		{
-			CycleFilterMode();
-		}
-		break;
-		}
 	}
 
 	ShaderID HardwareRasterizerDX11::AddEffect(Effect* pEffect)
@@ -164,7 +154,7 @@ namespace dae
 		//							5. Draw							   //
 		//=============================================================//
 
-		size_t techniqueIdx{ static_cast<size_t>(m_FilterMode) };
+		size_t techniqueIdx{ static_cast<size_t>(s_Settings.filterMode) };
 		D3DX11_TECHNIQUE_DESC techDesc{};
 		pActiveEffect->GetTechniqueByIndex(techniqueIdx)->GetDesc(&techDesc);
 		for (UINT p{}; p < techDesc.Passes; ++p)
@@ -384,30 +374,4 @@ namespace dae
 
 		return S_OK;
 	}
-	void HardwareRasterizerDX11::CycleFilterMode()
-	{
-		size_t filterMode{ static_cast<size_t>(m_FilterMode) };
-		if (++filterMode == static_cast<size_t>(FilterMode::End))
-		{
-			filterMode = 0;
-		}
-		m_FilterMode = static_cast<FilterMode>(filterMode);
-
-		TSTRING msg{ _T("Filter mode : ") };
-		switch (m_FilterMode)
-		{
-		case FilterMode::Point:
-			msg.append(_T("Point"));
-			break;
-
-		case FilterMode::Linear:
-			msg.append(_T("Linear"));
-			break;
-
-		case FilterMode::Anisotropic:
-			msg.append(_T("Anisotropic"));
-			break;
-		}
-		PrintMessage(msg, MSG_LOGGER_HARDWARERASTERIZER, MSG_COLOR_HARDWARERASTERIZER);
-	}
 }
\ No newline at end of file
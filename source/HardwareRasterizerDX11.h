@@ -10,11 +10,6 @@ namespace dae
 	class HardwareRasterizerDX11 : public Renderer
 	{
 	public:
-		enum class FilterMode
-		{
-			Point = 0, Linear = 1, Anisotropic = 2, End = 3
-		};
-
 		HardwareRasterizerDX11(SDL_Window* pWindow);
 		virtual ~HardwareRasterizerDX11() override;
 
@@ -40,8 +35,6 @@ namespace dae
 
 		HRESULT CreateRasterizerStates();
 
-		void CycleFilterMode();
-
 		static ID3D11Device* s_pDevice;
 		ID3D11DeviceContext* m_pDeviceContext{ nullptr };
 		IDXGISwapChain* m_pSwapChain{ nullptr };
@@ -51,8 +44,6 @@ namespace dae
 		ID3D11RenderTargetView* m_pRenderTargetView{ nullptr };
 		std::unordered_map<Renderer::FaceCullingMode, ID3D11RasterizerState*> m_pRasterizerStates;
 
-		FilterMode m_FilterMode{ FilterMode::Point };
-
 		static std::vector<std::unique_ptr<Effect>> s_pEffects;
 	};
 }
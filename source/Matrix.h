@@ -55,6 +55,8 @@ namespace dae {
 		Vector4 operator[](int index) const;
 		Matrix operator*(const Matrix& m) const;
 		const Matrix& operator*=(const Matrix& m);
+		// exact, no epsilon
+		bool operator==(const Matrix& m) const;
 
 	private:
 
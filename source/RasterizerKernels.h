@@ -0,0 +1,56 @@
+#pragma once
+#include "RasterizerSIMD.h"
+
+namespace dae
+{
+	namespace SIMD
+	{
+		// the vertex kernel reads the streams through plain pointers, see VertexStreams
+		struct VertexStreamData
+		{
+			const float* position[3]{};
+			const float* uv[2]{};
+			const float* normal[3]{};
+			const float* tangent[3]{};
+		};
+
+		// and writes Vertex_Out/Vertex_Screen through plain pointers to the members of vertex first, one vertex every stride elements,
+		// so no type of DataTypes.h gets compiled for the instruction set of a kernel (see RasterizerKernels.inl)
+		struct VertexOutputData
+		{
+			float* out[15]{};	// position xyzw, uv, normal, tangent, viewDirection
+			float* screen[4]{};	// position xy, depth, invW
+			uint32_t* pOutcode{};
+			size_t outStride{};	// in floats
+			size_t screenStride{};	// in floats (and uint32_t)
+		};
+
+		// one build of every kernel in RasterizerSIMD.h, RasterizerKernels.inl compiled for one instruction set
+		struct KernelTable
+		{
+			int blockWidth{};
+
+			uint32_t(*pRasterizeBlock)(const CoverageSetup&, const float*, const float*, int, CoverageBlock&) {};
+			uint32_t(*pInterpolateBlock)(const CoverageSetup&, const float*, const float*, int, CoverageBlock&) {};
+
+			void (*pInterpolateAttributes)(const AttributePlanes&, uint32_t, float, float, ShadingBlock&) {};
+			void (*pApplyNormalMap)(ShadingBlock&) {};
+			void (*pShadeObservedArea)(const LightSetup&, ShadingBlock&) {};
+			void (*pShadeDiffuse)(const LightSetup&, ShadingBlock&) {};
+			void (*pShadeSpecular)(const LightSetup&, ShadingBlock&) {};
+			void (*pShadeLambertPhong)(const LightSetup&, ShadingBlock&) {};
+
+			void (*pSampleTexels)(const TextureTexels&, TextureAddress, const float*, const float*, int, float (*)[MaxBlockWidth]) {};
+			void (*pSampleTexelsBilinear)(const TextureTexels&, TextureAddress, const float*, const float*, float, int, float (*)[MaxBlockWidth]) {};
+			void (*pStorePixels)(const PixelFormat&, const float (*)[MaxBlockWidth], uint32_t, uint32_t*) {};
+			void (*pBlendPixels)(const PixelFormat&, const float (*)[MaxBlockWidth], uint32_t, uint32_t*) {};
+
+			void (*pTransformVertices)(const VertexTransform&, const VertexStreamData&, size_t, size_t, const VertexOutputData&) {};
+		};
+
+		// compiled with /arch:SSE2 (the x64 baseline), /arch:AVX2 and /arch:AVX512
+		const KernelTable& GetKernelsSSE2();
+		const KernelTable& GetKernelsAVX2();
+		const KernelTable& GetKernelsAVX512();
+	}
+}
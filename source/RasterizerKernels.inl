@@ -0,0 +1,758 @@
+// kernels of RasterizerSIMD.h, written once against the FloatN/IntN helpers below
+// included by one RasterizerKernels*.cpp per instruction set, each compiled with its own /arch and without the precompiled header
+// everything in here has internal linkage, each instruction set gets its own copy
+// don't include anything beyond plain data headers and the intrinsics: an inline function (or template) of another header
+// emitted here is compiled with the instruction set of this file and the linker is free to pick that copy for the whole program
+#include "RasterizerKernels.h"
+
+#include <cfloat>
+#include <immintrin.h>
+
+#if defined(RASTERIZER_KERNELS_AVX512)
+#if !defined(__AVX512F__) || !defined(__AVX512VL__) || !defined(__AVX512DQ__)
+#error "the AVX-512 kernels have to be compiled with /arch:AVX512"
+#endif
+#elif defined(RASTERIZER_KERNELS_AVX2)
+#if !defined(__AVX2__)
+#error "the AVX2 kernels have to be compiled with /arch:AVX2"
+#endif
+#elif !defined(RASTERIZER_KERNELS_SSE2)
+#error "define the instruction set of the kernels before including RasterizerKernels.inl"
+#endif
+
+namespace dae
+{
+	namespace SIMD
+	{
+		namespace
+		{
+			//BlockWidth floats per register
+#if defined(RASTERIZER_KERNELS_AVX2) || defined(RASTERIZER_KERNELS_AVX512)
+			//AVX-512 keeps 8 lanes, spans never get wider than a coarse block (see SoftwareRasterizer::s_CoarseBlockSize)
+			constexpr int BlockWidth{ 8 };
+
+			using FloatN = __m256;
+			static inline FloatN LoadN(const float* p) { return _mm256_loadu_ps(p); }
+			static inline void StoreN(float* p, FloatN a) { _mm256_store_ps(p, a); }
+			static inline FloatN Set1N(float a) { return _mm256_set1_ps(a); }
+			static inline FloatN AddN(FloatN a, FloatN b) { return _mm256_add_ps(a, b); }
+			static inline FloatN SubN(FloatN a, FloatN b) { return _mm256_sub_ps(a, b); }
+			static inline FloatN MulN(FloatN a, FloatN b) { return _mm256_mul_ps(a, b); }
+			static inline FloatN DivN(FloatN a, FloatN b) { return _mm256_div_ps(a, b); }
+			static inline FloatN MulAddN(FloatN a, FloatN b, FloatN c) { return _mm256_fmadd_ps(a, b, c); }
+			static inline FloatN SqrtN(FloatN a) { return _mm256_sqrt_ps(a); }
+			static inline FloatN MinN(FloatN a, FloatN b) { return _mm256_min_ps(a, b); }
+			static inline FloatN MaxN(FloatN a, FloatN b) { return _mm256_max_ps(a, b); }
+			static inline FloatN GreaterN(FloatN a, FloatN b) { return _mm256_cmp_ps(a, b, _CMP_GT_OQ); }
+			static inline FloatN AndN(FloatN a, FloatN b) { return _mm256_and_ps(a, b); }
+			static inline FloatN LaneIndexN() { return _mm256_setr_ps(0.f, 1.f, 2.f, 3.f, 4.f, 5.f, 6.f, 7.f); }
+
+			using IntN = __m256i;
+			static inline IntN AsIntN(FloatN a) { return _mm256_castps_si256(a); }
+			static inline FloatN AsFloatN(IntN a) { return _mm256_castsi256_ps(a); }
+			static inline IntN Set1IntN(int a) { return _mm256_set1_epi32(a); }
+			static inline IntN AddIntN(IntN a, IntN b) { return _mm256_add_epi32(a, b); }
+			static inline IntN SubIntN(IntN a, IntN b) { return _mm256_sub_epi32(a, b); }
+			//product of lanes that fit in 16 bits, as long as the product does too
+			static inline IntN MulLo16N(IntN a, IntN b) { return _mm256_mullo_epi16(a, b); }
+			static inline IntN AndIntN(IntN a, IntN b) { return _mm256_and_si256(a, b); }
+			static inline IntN OrIntN(IntN a, IntN b) { return _mm256_or_si256(a, b); }
+			template <int Count> static inline IntN ShiftLeftN(IntN a) { return _mm256_slli_epi32(a, Count); }
+			template <int Count> static inline IntN ShiftRightN(IntN a) { return _mm256_srli_epi32(a, Count); }
+			static inline IntN ShiftLeftN(IntN a, int count) { return _mm256_sll_epi32(a, _mm_cvtsi32_si128(count)); }
+			static inline IntN ShiftRightN(IntN a, int count) { return _mm256_srl_epi32(a, _mm_cvtsi32_si128(count)); }
+			static inline IntN RoundToIntN(FloatN a) { return _mm256_cvtps_epi32(a); }
+			static inline IntN TruncateToIntN(FloatN a) { return _mm256_cvttps_epi32(a); }
+			static inline FloatN ToFloatN(IntN a) { return _mm256_cvtepi32_ps(a); }
+			static inline IntN GatherN(const uint32_t* p, IntN idx) { return _mm256_i32gather_epi32(reinterpret_cast<const int*>(p), idx, 4); }
+
+#if defined(RASTERIZER_KERNELS_AVX512)
+			//AVX-512VL, compares go straight to mask registers and memory accesses take them as is
+			static inline uint32_t LessMaskN(FloatN a, FloatN b) { return _mm256_cmp_ps_mask(a, b, _CMP_LT_OQ); }
+			static inline uint32_t LessEqualMaskN(FloatN a, FloatN b) { return _mm256_cmp_ps_mask(a, b, _CMP_LE_OQ); }
+			static inline uint32_t GreaterEqualMaskN(FloatN a, FloatN b) { return _mm256_cmp_ps_mask(a, b, _CMP_GE_OQ); }
+			static inline uint32_t EqualMaskN(FloatN a, FloatN b) { return _mm256_cmp_ps_mask(a, b, _CMP_EQ_OQ); }
+			static inline FloatN SelectN(FloatN mask, FloatN a, FloatN b) { return _mm256_mask_blend_ps(_mm256_movepi32_mask(AsIntN(mask)), b, a); }
+			static inline IntN LoadIntN(const uint32_t* p, uint32_t mask) { return _mm256_maskz_loadu_epi32(__mmask8(mask), p); }
+			static inline void StoreIntN(uint32_t* p, IntN a, uint32_t mask) { _mm256_mask_storeu_epi32(p, __mmask8(mask), a); }
+#else
+			static inline uint32_t LessMaskN(FloatN a, FloatN b) { return static_cast<uint32_t>(_mm256_movemask_ps(_mm256_cmp_ps(a, b, _CMP_LT_OQ))); }
+			static inline uint32_t LessEqualMaskN(FloatN a, FloatN b) { return static_cast<uint32_t>(_mm256_movemask_ps(_mm256_cmp_ps(a, b, _CMP_LE_OQ))); }
+			static inline uint32_t GreaterEqualMaskN(FloatN a, FloatN b) { return static_cast<uint32_t>(_mm256_movemask_ps(_mm256_cmp_ps(a, b, _CMP_GE_OQ))); }
+			static inline uint32_t EqualMaskN(FloatN a, FloatN b) { return static_cast<uint32_t>(_mm256_movemask_ps(_mm256_cmp_ps(a, b, _CMP_EQ_OQ))); }
+			static inline FloatN SelectN(FloatN mask, FloatN a, FloatN b) { return _mm256_blendv_ps(b, a, mask); }
+			//bit i of mask to all ones in lane i
+			static inline IntN ExpandMaskN(uint32_t mask)
+			{
+				const IntN laneBits{ _mm256_setr_epi32(1, 2, 4, 8, 16, 32, 64, 128) };
+				return _mm256_cmpeq_epi32(_mm256_and_si256(_mm256_set1_epi32(int(mask)), laneBits), laneBits);
+			}
+			static inline IntN LoadIntN(const uint32_t* p, uint32_t mask) { return _mm256_maskload_epi32(reinterpret_cast<const int*>(p), ExpandMaskN(mask)); }
+			static inline void StoreIntN(uint32_t* p, IntN a, uint32_t mask) { _mm256_maskstore_epi32(reinterpret_cast<int*>(p), ExpandMaskN(mask), a); }
+#endif
+#else
+			constexpr int BlockWidth{ 4 };
+
+			using FloatN = __m128;
+			static inline FloatN LoadN(const float* p) { return _mm_loadu_ps(p); }
+			static inline void StoreN(float* p, FloatN a) { _mm_store_ps(p, a); }
+			static inline FloatN Set1N(float a) { return _mm_set1_ps(a); }
+			static inline FloatN AddN(FloatN a, FloatN b) { return _mm_add_ps(a, b); }
+			static inline FloatN SubN(FloatN a, FloatN b) { return _mm_sub_ps(a, b); }
+			static inline FloatN MulN(FloatN a, FloatN b) { return _mm_mul_ps(a, b); }
+			static inline FloatN DivN(FloatN a, FloatN b) { return _mm_div_ps(a, b); }
+			static inline FloatN MulAddN(FloatN a, FloatN b, FloatN c) { return _mm_add_ps(_mm_mul_ps(a, b), c); }
+			static inline FloatN SqrtN(FloatN a) { return _mm_sqrt_ps(a); }
+			static inline uint32_t LessMaskN(FloatN a, FloatN b) { return static_cast<uint32_t>(_mm_movemask_ps(_mm_cmplt_ps(a, b))); }
+			static inline uint32_t LessEqualMaskN(FloatN a, FloatN b) { return static_cast<uint32_t>(_mm_movemask_ps(_mm_cmple_ps(a, b))); }
+			static inline uint32_t GreaterEqualMaskN(FloatN a, FloatN b) { return static_cast<uint32_t>(_mm_movemask_ps(_mm_cmpge_ps(a, b))); }
+			static inline uint32_t EqualMaskN(FloatN a, FloatN b) { return static_cast<uint32_t>(_mm_movemask_ps(_mm_cmpeq_ps(a, b))); }
+			static inline FloatN MinN(FloatN a, FloatN b) { return _mm_min_ps(a, b); }
+			static inline FloatN MaxN(FloatN a, FloatN b) { return _mm_max_ps(a, b); }
+			static inline FloatN GreaterN(FloatN a, FloatN b) { return _mm_cmpgt_ps(a, b); }
+			static inline FloatN AndN(FloatN a, FloatN b) { return _mm_and_ps(a, b); }
+			static inline FloatN SelectN(FloatN mask, FloatN a, FloatN b) { return _mm_or_ps(_mm_and_ps(mask, a), _mm_andnot_ps(mask, b)); }
+			static inline FloatN LaneIndexN() { return _mm_setr_ps(0.f, 1.f, 2.f, 3.f); }
+
+			using IntN = __m128i;
+			static inline IntN AsIntN(FloatN a) { return _mm_castps_si128(a); }
+			static inline FloatN AsFloatN(IntN a) { return _mm_castsi128_ps(a); }
+			static inline IntN Set1IntN(int a) { return _mm_set1_epi32(a); }
+			static inline IntN AddIntN(IntN a, IntN b) { return _mm_add_epi32(a, b); }
+			static inline IntN SubIntN(IntN a, IntN b) { return _mm_sub_epi32(a, b); }
+			//product of lanes that fit in 16 bits, as long as the product does too
+			static inline IntN MulLo16N(IntN a, IntN b) { return _mm_mullo_epi16(a, b); }
+			static inline IntN AndIntN(IntN a, IntN b) { return _mm_and_si128(a, b); }
+			static inline IntN OrIntN(IntN a, IntN b) { return _mm_or_si128(a, b); }
+			template <int Count> static inline IntN ShiftLeftN(IntN a) { return _mm_slli_epi32(a, Count); }
+			template <int Count> static inline IntN ShiftRightN(IntN a) { return _mm_srli_epi32(a, Count); }
+			static inline IntN ShiftLeftN(IntN a, int count) { return _mm_sll_epi32(a, _mm_cvtsi32_si128(count)); }
+			static inline IntN ShiftRightN(IntN a, int count) { return _mm_srl_epi32(a, _mm_cvtsi32_si128(count)); }
+			static inline IntN RoundToIntN(FloatN a) { return _mm_cvtps_epi32(a); }
+			static inline IntN TruncateToIntN(FloatN a) { return _mm_cvttps_epi32(a); }
+			static inline FloatN ToFloatN(IntN a) { return _mm_cvtepi32_ps(a); }
+			//no gather or masked loads before AVX2, the memory accesses stay scalar but the math doesn't
+			static inline IntN GatherN(const uint32_t* p, IntN idx)
+			{
+				alignas(16) int32_t offsets[BlockWidth];
+				_mm_store_si128(reinterpret_cast<__m128i*>(offsets), idx);
+				return _mm_setr_epi32(int(p[offsets[0]]), int(p[offsets[1]]), int(p[offsets[2]]), int(p[offsets[3]]));
+			}
+			static inline IntN LoadIntN(const uint32_t* p, uint32_t mask)
+			{
+				alignas(16) uint32_t lanes[BlockWidth]{};
+				for (int i{}; i < BlockWidth; ++i)
+				{
+					if (mask & (1u << i))
+						lanes[i] = p[i];
+				}
+				return _mm_load_si128(reinterpret_cast<const __m128i*>(lanes));
+			}
+			static inline void StoreIntN(uint32_t* p, IntN a, uint32_t mask)
+			{
+				alignas(16) uint32_t lanes[BlockWidth];
+				_mm_store_si128(reinterpret_cast<__m128i*>(lanes), a);
+				for (int i{}; i < BlockWidth; ++i)
+				{
+					if (mask & (1u << i))
+						p[i] = lanes[i];
+				}
+			}
+#endif
+
+			static_assert(BlockWidth <= MaxBlockWidth);
+
+			//PI_INV of MathHelpers.h, which isn't included here (see the top of the file)
+			constexpr float InvPi{ 1.f / 3.14159265358979323846f };
+
+			//SSE2 has no rounding instruction, truncation rounds negative values the wrong way
+			static inline FloatN FloorN(FloatN a)
+			{
+				const FloatN truncated{ ToFloatN(TruncateToIntN(a)) };
+				return SubN(truncated, AndN(GreaterN(truncated, a), Set1N(1.f)));
+			}
+
+			template <bool TestCoverage>
+			static uint32_t ProcessBlock(const CoverageSetup& setup, const float* edgeValues, const float* pDepth, int numPixels, CoverageBlock& block)
+			{
+				const FloatN laneIdx{ LaneIndexN() };
+				const FloatN zero{ Set1N(0.f) };
+				const FloatN one{ Set1N(1.f) };
+
+				const FloatN e0{ MulAddN(Set1N(setup.stepX[0]), laneIdx, Set1N(edgeValues[0])) };
+				const FloatN e1{ MulAddN(Set1N(setup.stepX[1]), laneIdx, Set1N(edgeValues[1])) };
+				const FloatN e2{ MulAddN(Set1N(setup.stepX[2]), laneIdx, Set1N(edgeValues[2])) };
+
+				uint32_t mask{ (1u << BlockWidth) - 1u };
+
+				//coverage
+				if constexpr (TestCoverage)
+				{
+					const uint32_t positive{ GreaterEqualMaskN(e0, zero) & GreaterEqualMaskN(e1, zero) & GreaterEqualMaskN(e2, zero) };
+					const uint32_t negative{ LessEqualMaskN(e0, zero) & LessEqualMaskN(e1, zero) & LessEqualMaskN(e2, zero) };
+
+					mask = 0;
+					if (setup.acceptPositive)
+						mask |= positive;
+					if (setup.acceptNegative)
+						mask |= negative;
+				}
+
+				if (numPixels < BlockWidth)
+					mask &= (1u << numPixels) - 1u;
+
+				if (mask == 0)
+					return 0;
+
+				//barycentric weights
+				const FloatN invArea{ Set1N(setup.invArea) };
+				const FloatN w0{ MulN(e0, invArea) };
+				const FloatN w1{ MulN(e1, invArea) };
+				const FloatN w2{ MulN(e2, invArea) };
+				StoreN(block.weights[0], w0);
+				StoreN(block.weights[1], w1);
+				StoreN(block.weights[2], w2);
+
+				//depth, z / w is linear in screenspace (and stays finite for vertices on the near plane)
+				const FloatN depth{ MulAddN(w2, Set1N(setup.depth[2]), MulAddN(w1, Set1N(setup.depth[1]), MulN(w0, Set1N(setup.depth[0])))) };
+				StoreN(block.depth, depth);
+
+				//don't read past the end of the row
+				FloatN storedDepth{};
+				if (numPixels >= BlockWidth)
+				{
+					storedDepth = LoadN(pDepth);
+				}
+				else
+				{
+					alignas(32) float partialDepth[BlockWidth]{};
+					for (int i{}; i < numPixels; ++i)
+						partialDepth[i] = pDepth[i];
+					storedDepth = LoadN(partialDepth);
+				}
+
+				const uint32_t inRange{ GreaterEqualMaskN(depth, zero) & LessEqualMaskN(depth, one) };
+				const uint32_t depthTest{ (setup.depthEqual)
+					? EqualMaskN(depth, storedDepth)
+					: LessMaskN(depth, storedDepth) };
+
+				return mask & inRange & depthTest;
+			}
+
+			static uint32_t RasterizeBlock(const CoverageSetup& setup, const float* edgeValues, const float* pDepth, int numPixels, CoverageBlock& block)
+			{
+				return ProcessBlock<true>(setup, edgeValues, pDepth, numPixels, block);
+			}
+
+			static uint32_t InterpolateBlock(const CoverageSetup& setup, const float* edgeValues, const float* pDepth, int numPixels, CoverageBlock& block)
+			{
+				return ProcessBlock<false>(setup, edgeValues, pDepth, numPixels, block);
+			}
+
+			//column c of the upper 3 rows of m applied to (x, y, z)
+			static inline FloatN TransformColumn(const float m[4][4], int c, FloatN x, FloatN y, FloatN z)
+			{
+				return MulAddN(Set1N(m[2][c]), z, MulAddN(Set1N(m[1][c]), y, MulN(Set1N(m[0][c]), x)));
+			}
+
+			static inline FloatN DotN(FloatN ax, FloatN ay, FloatN az, FloatN bx, FloatN by, FloatN bz)
+			{
+				return MulAddN(az, bz, MulAddN(ay, by, MulN(ax, bx)));
+			}
+
+			//same as Vector3::Normalize, divides by the length
+			static inline void NormalizeN(FloatN& x, FloatN& y, FloatN& z)
+			{
+				const FloatN length{ SqrtN(DotN(x, y, z, x, y, z)) };
+				x = DivN(x, length);
+				y = DivN(y, length);
+				z = DivN(z, length);
+			}
+
+			//log2 of a positive, normal float: exponent + polynomial of the mantissa in [sqrt(0.5), sqrt(2))
+			static inline FloatN Log2N(FloatN x)
+			{
+				const IntN bits{ AsIntN(x) };
+				//mantissa with the exponent of 0.5 .. 1
+				FloatN mantissa{ AsFloatN(OrIntN(AndIntN(bits, Set1IntN(0x007FFFFF)), Set1IntN(0x3F000000))) };
+				FloatN exponent{ ToFloatN(AddIntN(ShiftRightN<23>(bits), Set1IntN(-126))) };
+
+				//keep the mantissa around 1 where the polynomial is accurate
+				const FloatN isSmall{ GreaterN(Set1N(0.707106781f), mantissa) };
+				exponent = SubN(exponent, AndN(isSmall, Set1N(1.f)));
+				mantissa = SubN(AddN(mantissa, AndN(isSmall, mantissa)), Set1N(1.f));
+
+				const FloatN m2{ MulN(mantissa, mantissa) };
+				FloatN poly{ Set1N(7.0376836292e-2f) };
+				poly = MulAddN(poly, mantissa, Set1N(-1.1514610310e-1f));
+				poly = MulAddN(poly, mantissa, Set1N(1.1676998740e-1f));
+				poly = MulAddN(poly, mantissa, Set1N(-1.2420140846e-1f));
+				poly = MulAddN(poly, mantissa, Set1N(1.4249322787e-1f));
+				poly = MulAddN(poly, mantissa, Set1N(-1.6668057665e-1f));
+				poly = MulAddN(poly, mantissa, Set1N(2.0000714765e-1f));
+				poly = MulAddN(poly, mantissa, Set1N(-2.4999993993e-1f));
+				poly = MulAddN(poly, mantissa, Set1N(3.3333331174e-1f));
+
+				//natural log of the mantissa
+				FloatN ln{ MulN(MulN(poly, mantissa), m2) };
+				ln = SubN(ln, MulN(Set1N(0.5f), m2));
+				ln = AddN(ln, mantissa);
+
+				return MulAddN(ln, Set1N(1.44269504089f), exponent);
+			}
+
+			//2^x, rounded integer part goes in the exponent, polynomial for the fraction in [-0.5, 0.5]
+			static inline FloatN Exp2N(FloatN x)
+			{
+				x = MaxN(MinN(x, Set1N(127.f)), Set1N(-126.f));
+
+				const IntN whole{ RoundToIntN(x) };
+				const FloatN fraction{ SubN(x, ToFloatN(whole)) };
+
+				FloatN poly{ Set1N(1.535336188319500e-4f) };
+				poly = MulAddN(poly, fraction, Set1N(1.339887440266574e-3f));
+				poly = MulAddN(poly, fraction, Set1N(9.618437357674640e-3f));
+				poly = MulAddN(poly, fraction, Set1N(5.550332471162809e-2f));
+				poly = MulAddN(poly, fraction, Set1N(2.402264791363012e-1f));
+				poly = MulAddN(poly, fraction, Set1N(6.931472028550421e-1f));
+				poly = MulAddN(poly, fraction, Set1N(1.f));
+
+				const FloatN scale{ AsFloatN(ShiftLeftN<23>(AddIntN(whole, Set1IntN(127)))) };
+				return MulN(poly, scale);
+			}
+
+			//ks = 1 Phong term of SoftwareRasterizer::Phong, l points towards the light
+			static inline FloatN PhongN(FloatN exponent, FloatN lx, FloatN ly, FloatN lz,
+				FloatN vx, FloatN vy, FloatN vz, FloatN nx, FloatN ny, FloatN nz)
+			{
+				//reflect(l, n) = l - 2 * dot(l, n) * n
+				const FloatN twoDot{ MulN(Set1N(2.f), DotN(lx, ly, lz, nx, ny, nz)) };
+				const FloatN rx{ SubN(lx, MulN(twoDot, nx)) };
+				const FloatN ry{ SubN(ly, MulN(twoDot, ny)) };
+				const FloatN rz{ SubN(lz, MulN(twoDot, nz)) };
+
+				const FloatN cosAlpha{ DotN(vx, vy, vz, rx, ry, rz) };
+				const FloatN isLit{ GreaterN(cosAlpha, Set1N(0.f)) };
+				//unlit lanes are clamped to keep log2 finite, they are masked to 0 anyway
+				const FloatN safeCosAlpha{ MaxN(cosAlpha, Set1N(FLT_MIN)) };
+				return AndN(isLit, Exp2N(MulN(exponent, Log2N(safeCosAlpha))));
+			}
+
+			static inline FloatN ObservedAreaN(const LightSetup& light, FloatN nx, FloatN ny, FloatN nz)
+			{
+				const FloatN cosTheta{ DotN(nx, ny, nz, Set1N(-light.direction[0]), Set1N(-light.direction[1]), Set1N(-light.direction[2])) };
+				return MaxN(cosTheta, Set1N(0.f));
+			}
+
+			static inline FloatN SpecularN(const LightSetup& light, const ShadingBlock& block, FloatN nx, FloatN ny, FloatN nz)
+			{
+				const FloatN exponent{ MulN(LoadN(block.glossiness), Set1N(25.f)) };
+				const FloatN phong{ PhongN(exponent,
+					Set1N(-light.direction[0]), Set1N(-light.direction[1]), Set1N(-light.direction[2]),
+					LoadN(block.viewDirection[0]), LoadN(block.viewDirection[1]), LoadN(block.viewDirection[2]),
+					nx, ny, nz) };
+				return MulN(LoadN(block.specular), phong);
+			}
+
+			static void InterpolateAttributes(const AttributePlanes& planes, uint32_t varyings, float x, float y, ShadingBlock& block)
+			{
+				const FloatN dx{ AddN(Set1N(x - planes.origin[0]), LaneIndexN()) };
+				const float dy{ y - planes.origin[1] };
+				const auto evaluate = [&planes, dx, dy](size_t attribute)
+					{
+						return MulAddN(Set1N(planes.ddx[attribute]), dx, Set1N(planes.value[attribute] + planes.ddy[attribute] * dy));
+					};
+
+				//only uv needs the actual w, normalizing takes care of it for the directions (w is positive inside the frustum)
+				if (varyings & VaryingUV)
+				{
+					const FloatN interpolatedW{ DivN(Set1N(1.f), evaluate(InvWAttribute)) };
+					StoreN(block.uv[0], MulN(evaluate(0), interpolatedW));
+					StoreN(block.uv[1], MulN(evaluate(1), interpolatedW));
+				}
+
+				const auto evaluateDirection = [&evaluate](size_t firstAttribute, float (&out)[3][MaxBlockWidth])
+					{
+						FloatN x{ evaluate(firstAttribute) };
+						FloatN y{ evaluate(firstAttribute + 1) };
+						FloatN z{ evaluate(firstAttribute + 2) };
+						NormalizeN(x, y, z);
+						StoreN(out[0], x);
+						StoreN(out[1], y);
+						StoreN(out[2], z);
+					};
+
+				if (varyings & VaryingNormal)
+					evaluateDirection(2, block.normal);
+				if (varyings & VaryingTangent)
+					evaluateDirection(5, block.tangent);
+				if (varyings & VaryingViewDirection)
+					evaluateDirection(8, block.viewDirection);
+			}
+
+			static void ApplyNormalMap(ShadingBlock& block)
+			{
+				const FloatN one{ Set1N(1.f) };
+				const FloatN two{ Set1N(2.f) };
+
+				const FloatN nx{ LoadN(block.normal[0]) }, ny{ LoadN(block.normal[1]) }, nz{ LoadN(block.normal[2]) };
+				const FloatN tx{ LoadN(block.tangent[0]) }, ty{ LoadN(block.tangent[1]) }, tz{ LoadN(block.tangent[2]) };
+
+				//binormal = normalized cross(normal, tangent)
+				FloatN bx{ SubN(MulN(ny, tz), MulN(nz, ty)) };
+				FloatN by{ SubN(MulN(nz, tx), MulN(nx, tz)) };
+				FloatN bz{ SubN(MulN(nx, ty), MulN(ny, tx)) };
+				NormalizeN(bx, by, bz);
+
+				const FloatN sx{ SubN(MulN(two, LoadN(block.normalSample[0])), one) };
+				const FloatN sy{ SubN(MulN(two, LoadN(block.normalSample[1])), one) };
+				const FloatN sz{ SubN(MulN(two, LoadN(block.normalSample[2])), one) };
+
+				//tangent, binormal and normal are the rows of the tangent frame
+				FloatN x{ MulAddN(nx, sz, MulAddN(bx, sy, MulN(tx, sx))) };
+				FloatN y{ MulAddN(ny, sz, MulAddN(by, sy, MulN(ty, sx))) };
+				FloatN z{ MulAddN(nz, sz, MulAddN(bz, sy, MulN(tz, sx))) };
+				NormalizeN(x, y, z);
+
+				StoreN(block.normal[0], x);
+				StoreN(block.normal[1], y);
+				StoreN(block.normal[2], z);
+			}
+
+			static void ShadeObservedArea(const LightSetup& light, ShadingBlock& block)
+			{
+				const FloatN observedArea{ ObservedAreaN(light, LoadN(block.normal[0]), LoadN(block.normal[1]), LoadN(block.normal[2])) };
+				StoreN(block.color[0], observedArea);
+				StoreN(block.color[1], observedArea);
+				StoreN(block.color[2], observedArea);
+			}
+
+			static void ShadeDiffuse(const LightSetup& light, ShadingBlock& block)
+			{
+				const FloatN observedArea{ ObservedAreaN(light, LoadN(block.normal[0]), LoadN(block.normal[1]), LoadN(block.normal[2])) };
+				//Lambert with kd = 1
+				const FloatN scale{ MulN(observedArea, Set1N(InvPi * light.intensity)) };
+				for (int c{}; c < 3; ++c)
+				{
+					StoreN(block.color[c], MulN(LoadN(block.diffuse[c]), scale));
+				}
+			}
+
+			static void ShadeSpecular(const LightSetup& light, ShadingBlock& block)
+			{
+				const FloatN specular{ SpecularN(light, block, LoadN(block.normal[0]), LoadN(block.normal[1]), LoadN(block.normal[2])) };
+				StoreN(block.color[0], specular);
+				StoreN(block.color[1], specular);
+				StoreN(block.color[2], specular);
+			}
+
+			static void ShadeLambertPhong(const LightSetup& light, ShadingBlock& block)
+			{
+				const FloatN nx{ LoadN(block.normal[0]) }, ny{ LoadN(block.normal[1]) }, nz{ LoadN(block.normal[2]) };
+				const FloatN observedArea{ ObservedAreaN(light, nx, ny, nz) };
+				const FloatN specular{ SpecularN(light, block, nx, ny, nz) };
+
+				//ambient + specular + diffuse * observed area * intensity
+				const FloatN ambientSpecular{ AddN(Set1N(0.025f), specular) };
+				const FloatN scale{ MulN(observedArea, Set1N(InvPi * light.intensity)) };
+				for (int c{}; c < 3; ++c)
+				{
+					StoreN(block.color[c], MulAddN(LoadN(block.diffuse[c]), scale, ambientSpecular));
+				}
+			}
+
+			//uvs are limited to this many repetitions of the texture, texel coordinates stay exact in float
+			//NaN (lanes outside the triangle) ends up at the lower bound, uv is the first operand
+			static inline FloatN LoadUVN(const float* p)
+			{
+				constexpr float maxRepeat{ 1024.f };
+				return MinN(MaxN(LoadN(p), Set1N(-maxRepeat)), Set1N(maxRepeat));
+			}
+
+			//maps integer texel coordinates (in float) outside [0, size) back in
+			static inline FloatN AddressTexelsN(FloatN texel, int size, TextureAddress address)
+			{
+				const FloatN lastTexel{ Set1N(float(size - 1)) };
+				switch (address)
+				{
+				case TextureAddress::Wrap:
+					texel = SubN(texel, MulN(FloorN(MulN(texel, Set1N(1.f / size))), Set1N(float(size))));
+					break;
+
+				case TextureAddress::Mirror:
+				{
+					//every other repetition is flipped
+					const FloatN period{ Set1N(2.f * size) };
+					texel = SubN(texel, MulN(FloorN(MulN(texel, Set1N(0.5f / size))), period));
+					texel = SelectN(GreaterN(texel, lastTexel), SubN(SubN(period, Set1N(1.f)), texel), texel);
+				}
+					break;
+
+				default:
+					break;
+				}
+
+				//clamp, for the other modes it only catches the rounding of the divisions
+				return MinN(MaxN(texel, Set1N(0.f)), lastTexel);
+			}
+
+			static inline IntN GetTexelIndexN(const TextureTexels& texture, IntN texelX, IntN texelY)
+			{
+				if (texture.blocksPerRow == 0)
+				{
+					//x + y * width in float, exact for textures up to 2^24 texels
+					return TruncateToIntN(MulAddN(ToFloatN(texelY), Set1N(float(texture.width)), ToFloatN(texelX)));
+				}
+
+				//block index the same way, the texel within the block is a few bits
+				const IntN blockMask{ Set1IntN(TexelBlockSize - 1) };
+				const FloatN blockIdx{ MulAddN(ToFloatN(ShiftRightN<TexelBlockShift>(texelY)), Set1N(float(texture.blocksPerRow)), ToFloatN(ShiftRightN<TexelBlockShift>(texelX))) };
+				return OrIntN(ShiftLeftN<2 * TexelBlockShift>(TruncateToIntN(blockIdx)),
+					OrIntN(ShiftLeftN<TexelBlockShift>(AndIntN(texelY, blockMask)), AndIntN(texelX, blockMask)));
+			}
+
+			static void SampleTexels(const TextureTexels& texture, TextureAddress address, const float* pU, const float* pV, int numChannels, float (*pChannels)[MaxBlockWidth])
+			{
+				const FloatN x{ AddressTexelsN(FloorN(MulN(LoadUVN(pU), Set1N(float(texture.width)))), texture.width, address) };
+				const FloatN y{ AddressTexelsN(FloorN(MulN(LoadUVN(pV), Set1N(float(texture.height)))), texture.height, address) };
+				const IntN texels{ GatherN(texture.pTexels, GetTexelIndexN(texture, TruncateToIntN(x), TruncateToIntN(y))) };
+
+				const IntN channelMask{ Set1IntN(0xFF) };
+				const FloatN colorDivider{ Set1N(1.f / 255.f) };
+				for (int c{}; c < numChannels; ++c)
+				{
+					const IntN channel{ AndIntN(ShiftRightN(texels, 8 * c), channelMask) };
+					StoreN(pChannels[c], MulN(ToFloatN(channel), colorDivider));
+				}
+			}
+
+			static void SampleTexelsBilinear(const TextureTexels& texture, TextureAddress address, const float* pU, const float* pV, float weight, int numChannels, float (*pChannels)[MaxBlockWidth])
+			{
+				//texel centers are at .5, the 2x2 texels around the uv start at the one up and left of it
+				const FloatN s{ MulAddN(LoadUVN(pU), Set1N(float(texture.width)), Set1N(-0.5f)) };
+				const FloatN t{ MulAddN(LoadUVN(pV), Set1N(float(texture.height)), Set1N(-0.5f)) };
+				const FloatN left{ FloorN(s) };
+				const FloatN top{ FloorN(t) };
+
+				//weights of the right/bottom texels in 1/256
+				const IntN fullWeight{ Set1IntN(256) };
+				const IntN weightX{ TruncateToIntN(MulN(SubN(s, left), Set1N(256.f))) };
+				const IntN weightY{ TruncateToIntN(MulN(SubN(t, top), Set1N(256.f))) };
+				const IntN invWeightX{ SubIntN(fullWeight, weightX) };
+				const IntN invWeightY{ SubIntN(fullWeight, weightY) };
+
+				const FloatN one{ Set1N(1.f) };
+				const IntN x0{ TruncateToIntN(AddressTexelsN(left, texture.width, address)) };
+				const IntN x1{ TruncateToIntN(AddressTexelsN(AddN(left, one), texture.width, address)) };
+				const IntN y0{ TruncateToIntN(AddressTexelsN(top, texture.height, address)) };
+				const IntN y1{ TruncateToIntN(AddressTexelsN(AddN(top, one), texture.height, address)) };
+				const IntN texels[4]
+				{
+					GatherN(texture.pTexels, GetTexelIndexN(texture, x0, y0)),
+					GatherN(texture.pTexels, GetTexelIndexN(texture, x1, y0)),
+					GatherN(texture.pTexels, GetTexelIndexN(texture, x0, y1)),
+					GatherN(texture.pTexels, GetTexelIndexN(texture, x1, y1))
+				};
+
+				const IntN channelMask{ Set1IntN(0xFF) };
+				const IntN half{ Set1IntN(128) };
+				const FloatN scale{ Set1N(weight / 255.f) };
+				for (int c{}; c < numChannels; ++c)
+				{
+					const int shift{ 8 * c };
+					const auto channel = [shift, channelMask](IntN texel)
+						{
+							return AndIntN(ShiftRightN(texel, shift), channelMask);
+						};
+
+					//255 * 256 fits in 16 bits, every lerp is rounded back to 8 bits before the next one
+					const IntN topRow{ ShiftRightN<8>(AddIntN(AddIntN(MulLo16N(channel(texels[0]), invWeightX), MulLo16N(channel(texels[1]), weightX)), half)) };
+					const IntN bottomRow{ ShiftRightN<8>(AddIntN(AddIntN(MulLo16N(channel(texels[2]), invWeightX), MulLo16N(channel(texels[3]), weightX)), half)) };
+					const IntN filtered{ ShiftRightN<8>(AddIntN(AddIntN(MulLo16N(topRow, invWeightY), MulLo16N(bottomRow, weightY)), half)) };
+					StoreN(pChannels[c], MulAddN(ToFloatN(filtered), scale, LoadN(pChannels[c])));
+				}
+			}
+
+			//ColorRGB::MaxToOne + the 8 bit conversion of SDL_MapRGB
+			static inline IntN PackPixelsN(const PixelFormat& format, FloatN r, FloatN g, FloatN b)
+			{
+				const FloatN one{ Set1N(1.f) };
+				const FloatN maxValue{ MaxN(MaxN(MaxN(r, g), b), one) };
+				const FloatN channels[3]{ DivN(r, maxValue), DivN(g, maxValue), DivN(b, maxValue) };
+
+				IntN pixels{ Set1IntN(int(format.alphaMask)) };
+				for (int c{}; c < 3; ++c)
+				{
+					const IntN channel{ TruncateToIntN(MulN(channels[c], Set1N(255.f))) };
+					pixels = OrIntN(pixels, ShiftLeftN(channel, int(format.channelShift[c])));
+				}
+				return pixels;
+			}
+
+			static void StorePixels(const PixelFormat& format, const float (*pColor)[MaxBlockWidth], uint32_t mask, uint32_t* pPixels)
+			{
+				StoreIntN(pPixels, PackPixelsN(format, LoadN(pColor[0]), LoadN(pColor[1]), LoadN(pColor[2])), mask);
+			}
+
+			static void BlendPixels(const PixelFormat& format, const float (*pRGBA)[MaxBlockWidth], uint32_t mask, uint32_t* pPixels)
+			{
+				const IntN pixels{ LoadIntN(pPixels, mask) };
+				const IntN channelMask{ Set1IntN(0xFF) };
+				const FloatN colorDivider{ Set1N(1.f / 255.f) };
+
+				//nearly transparent lanes keep the stored color
+				const FloatN alpha{ LoadN(pRGBA[3]) };
+				const FloatN isVisible{ GreaterN(alpha, Set1N(0.0001f)) };
+				const FloatN oneMinusAlpha{ SubN(Set1N(1.f), alpha) };
+
+				FloatN blended[3]{};
+				for (int c{}; c < 3; ++c)
+				{
+					const FloatN stored{ MulN(ToFloatN(AndIntN(ShiftRightN(pixels, int(format.channelShift[c])), channelMask)), colorDivider) };
+					//Lerpf: (1 - alpha) * stored + alpha * color
+					const FloatN lerped{ AddN(MulN(oneMinusAlpha, stored), MulN(alpha, LoadN(pRGBA[c]))) };
+					blended[c] = SelectN(isVisible, lerped, stored);
+				}
+
+				StoreIntN(pPixels, PackPixelsN(format, blended[0], blended[1], blended[2]), mask);
+			}
+
+			static void TransformVertices(const VertexTransform& transform, const VertexStreamData& vertices, size_t first, size_t count, const VertexOutputData& outputs)
+			{
+				const FloatN zero{ Set1N(0.f) };
+				const FloatN one{ Set1N(1.f) };
+				const FloatN half{ Set1N(0.5f) };
+				const FloatN viewportWidth{ Set1N(transform.viewportWidth) };
+				const FloatN viewportHeight{ Set1N(transform.viewportHeight) };
+				const FloatN guardBand{ Set1N(transform.guardBand) };
+
+				const float (&wvp)[4][4]{ transform.worldViewProjection };
+				const float (&world)[4][4]{ transform.world };
+
+				//results of one block, transposed back into the outputs afterwards
+				alignas(32) float out[15][BlockWidth];
+				alignas(32) float screen[4][BlockWidth];
+
+				const size_t end{ first + count };
+				for (size_t blockStart{ first }; blockStart < end; blockStart += BlockWidth)
+				{
+					const FloatN posX{ LoadN(vertices.position[0] + blockStart) };
+					const FloatN posY{ LoadN(vertices.position[1] + blockStart) };
+					const FloatN posZ{ LoadN(vertices.position[2] + blockStart) };
+
+					//position to clipspace
+					const FloatN clipX{ AddN(TransformColumn(wvp, 0, posX, posY, posZ), Set1N(wvp[3][0])) };
+					const FloatN clipY{ AddN(TransformColumn(wvp, 1, posX, posY, posZ), Set1N(wvp[3][1])) };
+					const FloatN clipZ{ AddN(TransformColumn(wvp, 2, posX, posY, posZ), Set1N(wvp[3][2])) };
+					const FloatN clipW{ AddN(TransformColumn(wvp, 3, posX, posY, posZ), Set1N(wvp[3][3])) };
+					StoreN(out[0], clipX);
+					StoreN(out[1], clipY);
+					StoreN(out[2], clipZ);
+					StoreN(out[3], clipW);
+
+					//perspective divide + viewport, meaningless for w <= 0 but those vertices get clipped against the near plane
+					const FloatN invW{ DivN(one, clipW) };
+					StoreN(screen[0], MulN(MulN(AddN(MulN(clipX, invW), one), half), viewportWidth));
+					StoreN(screen[1], MulN(MulN(SubN(one, MulN(clipY, invW)), half), viewportHeight));
+					StoreN(screen[2], MulN(clipZ, invW));
+					StoreN(screen[3], invW);
+
+					//one bit per lane for every plane
+					const FloatN negW{ SubN(zero, clipW) };
+					const FloatN guardBandW{ MulN(guardBand, clipW) };
+					const FloatN negGuardBandW{ SubN(zero, guardBandW) };
+					const uint32_t planeMasks[10]
+					{
+						LessMaskN(clipX, negW),
+						LessMaskN(clipW, clipX),
+						LessMaskN(clipY, negW),
+						LessMaskN(clipW, clipY),
+						LessMaskN(clipZ, zero),
+						LessMaskN(clipW, clipZ),
+						LessMaskN(clipX, negGuardBandW),
+						LessMaskN(guardBandW, clipX),
+						LessMaskN(clipY, negGuardBandW),
+						LessMaskN(guardBandW, clipY)
+					};
+
+					StoreN(out[4], LoadN(vertices.uv[0] + blockStart));
+					StoreN(out[5], LoadN(vertices.uv[1] + blockStart));
+
+					//normal + tangent to worldspace
+					const FloatN normalX{ LoadN(vertices.normal[0] + blockStart) };
+					const FloatN normalY{ LoadN(vertices.normal[1] + blockStart) };
+					const FloatN normalZ{ LoadN(vertices.normal[2] + blockStart) };
+					StoreN(out[6], TransformColumn(world, 0, normalX, normalY, normalZ));
+					StoreN(out[7], TransformColumn(world, 1, normalX, normalY, normalZ));
+					StoreN(out[8], TransformColumn(world, 2, normalX, normalY, normalZ));
+
+					const FloatN tangentX{ LoadN(vertices.tangent[0] + blockStart) };
+					const FloatN tangentY{ LoadN(vertices.tangent[1] + blockStart) };
+					const FloatN tangentZ{ LoadN(vertices.tangent[2] + blockStart) };
+					StoreN(out[9], TransformColumn(world, 0, tangentX, tangentY, tangentZ));
+					StoreN(out[10], TransformColumn(world, 1, tangentX, tangentY, tangentZ));
+					StoreN(out[11], TransformColumn(world, 2, tangentX, tangentY, tangentZ));
+
+					//normalized direction from the camera to the worldspace position
+					if (transform.computeViewDirection)
+					{
+						const FloatN viewX{ SubN(AddN(TransformColumn(world, 0, posX, posY, posZ), Set1N(world[3][0])), Set1N(transform.cameraOrigin[0])) };
+						const FloatN viewY{ SubN(AddN(TransformColumn(world, 1, posX, posY, posZ), Set1N(world[3][1])), Set1N(transform.cameraOrigin[1])) };
+						const FloatN viewZ{ SubN(AddN(TransformColumn(world, 2, posX, posY, posZ), Set1N(world[3][2])), Set1N(transform.cameraOrigin[2])) };
+						const FloatN viewLength{ SqrtN(MulAddN(viewZ, viewZ, MulAddN(viewY, viewY, MulN(viewX, viewX)))) };
+						StoreN(out[12], DivN(viewX, viewLength));
+						StoreN(out[13], DivN(viewY, viewLength));
+						StoreN(out[14], DivN(viewZ, viewLength));
+					}
+					else
+					{
+						StoreN(out[12], zero);
+						StoreN(out[13], zero);
+						StoreN(out[14], zero);
+					}
+
+					const size_t numVertices{ (end - blockStart < size_t(BlockWidth)) ? end - blockStart : size_t(BlockWidth) };
+					for (size_t i{}; i < numVertices; ++i)
+					{
+						const size_t outIdx{ (blockStart - first + i) * outputs.outStride };
+						for (int member{}; member < 15; ++member)
+						{
+							outputs.out[member][outIdx] = out[member][i];
+						}
+
+						const size_t screenIdx{ (blockStart - first + i) * outputs.screenStride };
+						for (int member{}; member < 4; ++member)
+						{
+							outputs.screen[member][screenIdx] = screen[member][i];
+						}
+
+						uint32_t outcode{};
+						for (uint32_t plane{}; plane < 10; ++plane)
+						{
+							outcode |= ((planeMasks[plane] >> i) & 1u) << plane;
+						}
+						outputs.pOutcode[screenIdx] = outcode;
+					}
+				}
+			}
+
+			constexpr KernelTable s_Kernels
+			{
+				BlockWidth,
+				&RasterizeBlock,
+				&InterpolateBlock,
+				&InterpolateAttributes,
+				&ApplyNormalMap,
+				&ShadeObservedArea,
+				&ShadeDiffuse,
+				&ShadeSpecular,
+				&ShadeLambertPhong,
+				&SampleTexels,
+				&SampleTexelsBilinear,
+				&StorePixels,
+				&BlendPixels,
+				&TransformVertices
+			};
+		}
+	}
+}
@@ -0,0 +1,14 @@
+// AVX2 + FMA build of the software rasterizer kernels, compiled with /arch:AVX2
+#define RASTERIZER_KERNELS_AVX2
+#include "RasterizerKernels.inl"
+
+namespace dae
+{
+	namespace SIMD
+	{
+		const KernelTable& GetKernelsAVX2()
+		{
+			return s_Kernels;
+		}
+	}
+}
@@ -0,0 +1,14 @@
+// AVX-512 build of the software rasterizer kernels, compiled with /arch:AVX512
+#define RASTERIZER_KERNELS_AVX512
+#include "RasterizerKernels.inl"
+
+namespace dae
+{
+	namespace SIMD
+	{
+		const KernelTable& GetKernelsAVX512()
+		{
+			return s_Kernels;
+		}
+	}
+}
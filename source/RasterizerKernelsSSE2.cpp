@@ -0,0 +1,14 @@
+// SSE2 build of the software rasterizer kernels, the x64 baseline every cpu runs
+#define RASTERIZER_KERNELS_SSE2
+#include "RasterizerKernels.inl"
+
+namespace dae
+{
+	namespace SIMD
+	{
+		const KernelTable& GetKernelsSSE2()
+		{
+			return s_Kernels;
+		}
+	}
+}
@@ -0,0 +1,204 @@
+#include "pch.h"
+#include "RasterizerSIMD.h"
+#include "RasterizerKernels.h"
+#include "DataTypes.h"
+
+#if defined(_MSC_VER)
+#include <intrin.h>
+#else
+#include <cpuid.h>
+#endif
+
+namespace dae
+{
+	namespace SIMD
+	{
+		static void CpuId(int leaf, int subLeaf, int (&registers)[4])
+		{
+#if defined(_MSC_VER)
+			__cpuidex(registers, leaf, subLeaf);
+#else
+			unsigned int eax{}, ebx{}, ecx{}, edx{};
+			__cpuid_count(leaf, subLeaf, eax, ebx, ecx, edx);
+			registers[0] = int(eax);
+			registers[1] = int(ebx);
+			registers[2] = int(ecx);
+			registers[3] = int(edx);
+#endif
+		}
+
+		//register state the os saves on a context switch, only valid when cpuid reports OSXSAVE
+		static uint64_t GetEnabledRegisterState()
+		{
+#if defined(_MSC_VER)
+			return _xgetbv(0);
+#else
+			unsigned int eax{}, edx{};
+			__asm__("xgetbv" : "=a"(eax), "=d"(edx) : "c"(0));
+			return (uint64_t(edx) << 32) | eax;
+#endif
+		}
+
+		static InstructionSet DetectInstructionSet()
+		{
+			int registers[4]{};
+			CpuId(0, 0, registers);
+			const int maxLeaf{ registers[0] };
+			if (maxLeaf < 7)
+				return InstructionSet::SSE2;
+
+			//leaf 1 ecx: FMA, OSXSAVE, AVX
+			CpuId(1, 0, registers);
+			constexpr int avxBits{ (1 << 12) | (1 << 27) | (1 << 28) };
+			if ((registers[2] & avxBits) != avxBits)
+				return InstructionSet::SSE2;
+
+			//xmm + ymm state
+			const uint64_t registerState{ GetEnabledRegisterState() };
+			if ((registerState & 0x6) != 0x6)
+				return InstructionSet::SSE2;
+
+			//leaf 7 ebx: BMI1, AVX2, BMI2, /arch:AVX2 is free to use all of them
+			CpuId(7, 0, registers);
+			constexpr int avx2Bits{ (1 << 3) | (1 << 5) | (1 << 8) };
+			if ((registers[1] & avx2Bits) != avx2Bits)
+				return InstructionSet::SSE2;
+
+			//F, DQ, CD, BW, VL (what /arch:AVX512 enables) + opmask and zmm state
+			constexpr int avx512Bits{ (1 << 16) | (1 << 17) | (1 << 28) | (1 << 30) | int(1u << 31) };
+			if ((registers[1] & avx512Bits) != avx512Bits || (registerState & 0xE6) != 0xE6)
+				return InstructionSet::AVX2;
+
+			return InstructionSet::AVX512;
+		}
+
+		static const KernelTable& GetKernels(InstructionSet instructionSet)
+		{
+			switch (instructionSet)
+			{
+			case InstructionSet::AVX512:
+				return GetKernelsAVX512();
+
+			case InstructionSet::AVX2:
+				return GetKernelsAVX2();
+
+			default:
+				return GetKernelsSSE2();
+			}
+		}
+
+		static const InstructionSet s_SupportedInstructionSet{ DetectInstructionSet() };
+		static const KernelTable* s_pKernels{ &GetKernels(s_SupportedInstructionSet) };
+
+		InstructionSet GetSupportedInstructionSet()
+		{
+			return s_SupportedInstructionSet;
+		}
+
+		InstructionSet SetInstructionSet(InstructionSet instructionSet)
+		{
+			if (instructionSet >= InstructionSet::End || instructionSet > s_SupportedInstructionSet)
+				instructionSet = s_SupportedInstructionSet;
+
+			s_pKernels = &GetKernels(instructionSet);
+			return instructionSet;
+		}
+
+		int GetBlockWidth()
+		{
+			return s_pKernels->blockWidth;
+		}
+
+		uint32_t RasterizeBlock(const CoverageSetup& setup, const float* edgeValues, const float* pDepth, int numPixels, CoverageBlock& block)
+		{
+			return s_pKernels->pRasterizeBlock(setup, edgeValues, pDepth, numPixels, block);
+		}
+
+		uint32_t InterpolateBlock(const CoverageSetup& setup, const float* edgeValues, const float* pDepth, int numPixels, CoverageBlock& block)
+		{
+			return s_pKernels->pInterpolateBlock(setup, edgeValues, pDepth, numPixels, block);
+		}
+
+		void InterpolateAttributes(const AttributePlanes& planes, uint32_t varyings, float x, float y, ShadingBlock& block)
+		{
+			s_pKernels->pInterpolateAttributes(planes, varyings, x, y, block);
+		}
+
+		void ApplyNormalMap(ShadingBlock& block)
+		{
+			s_pKernels->pApplyNormalMap(block);
+		}
+
+		void ShadeObservedArea(const LightSetup& light, ShadingBlock& block)
+		{
+			s_pKernels->pShadeObservedArea(light, block);
+		}
+
+		void ShadeDiffuse(const LightSetup& light, ShadingBlock& block)
+		{
+			s_pKernels->pShadeDiffuse(light, block);
+		}
+
+		void ShadeSpecular(const LightSetup& light, ShadingBlock& block)
+		{
+			s_pKernels->pShadeSpecular(light, block);
+		}
+
+		void ShadeLambertPhong(const LightSetup& light, ShadingBlock& block)
+		{
+			s_pKernels->pShadeLambertPhong(light, block);
+		}
+
+		void SampleTexels(const TextureTexels& texture, TextureAddress address, const float* pU, const float* pV, int numChannels, float (*pChannels)[MaxBlockWidth])
+		{
+			s_pKernels->pSampleTexels(texture, address, pU, pV, numChannels, pChannels);
+		}
+
+		void SampleTexelsBilinear(const TextureTexels& texture, TextureAddress address, const float* pU, const float* pV, float weight, int numChannels, float (*pChannels)[MaxBlockWidth])
+		{
+			s_pKernels->pSampleTexelsBilinear(texture, address, pU, pV, weight, numChannels, pChannels);
+		}
+
+		void StorePixels(const PixelFormat& format, const float (*pColor)[MaxBlockWidth], uint32_t mask, uint32_t* pPixels)
+		{
+			s_pKernels->pStorePixels(format, pColor, mask, pPixels);
+		}
+
+		void BlendPixels(const PixelFormat& format, const float (*pRGBA)[MaxBlockWidth], uint32_t mask, uint32_t* pPixels)
+		{
+			s_pKernels->pBlendPixels(format, pRGBA, mask, pPixels);
+		}
+
+		void TransformVertices(const VertexTransform& transform, const VertexStreams& vertices, size_t first, size_t count, Vertex_Out* pOut, Vertex_Screen* pScreen)
+		{
+			if (count == 0)
+				return;
+
+			const VertexStreamData streams
+			{
+				{ vertices.positionX.data(), vertices.positionY.data(), vertices.positionZ.data() },
+				{ vertices.u.data(), vertices.v.data() },
+				{ vertices.normalX.data(), vertices.normalY.data(), vertices.normalZ.data() },
+				{ vertices.tangentX.data(), vertices.tangentY.data(), vertices.tangentZ.data() }
+			};
+			static_assert(sizeof(Vertex_Out) % sizeof(float) == 0 && sizeof(Vertex_Screen) % sizeof(float) == 0 && sizeof(uint32_t) == sizeof(float));
+			Vertex_Out& out{ pOut[first] };
+			Vertex_Screen& screen{ pScreen[first] };
+			const VertexOutputData outputs
+			{
+				{
+					&out.position.x, &out.position.y, &out.position.z, &out.position.w,
+					&out.uv.x, &out.uv.y,
+					&out.normal.x, &out.normal.y, &out.normal.z,
+					&out.tangent.x, &out.tangent.y, &out.tangent.z,
+					&out.viewDirection.x, &out.viewDirection.y, &out.viewDirection.z
+				},
+				{ &screen.position.x, &screen.position.y, &screen.depth, &screen.invW },
+				&screen.outcode,
+				sizeof(Vertex_Out) / sizeof(float),
+				sizeof(Vertex_Screen) / sizeof(float)
+			};
+			s_pKernels->pTransformVertices(transform, streams, first, count, outputs);
+		}
+	}
+}
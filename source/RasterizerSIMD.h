@@ -0,0 +1,203 @@
+#pragma once
+#include <cstdint>
+#include <cstddef>
+
+namespace dae
+{
+	struct VertexStreams;
+	struct Vertex_Out;
+	struct Vertex_Screen;
+
+	namespace SIMD
+	{
+		// kernel variants, every one is compiled in its own translation unit (RasterizerKernels*.cpp)
+		// the best one the cpu and os support is picked at startup
+		enum class InstructionSet
+		{
+			SSE2 = 0, AVX2 = 1, AVX512 = 2, End = 3
+		};
+
+		// highest instruction set the cpu supports and the os saves the registers of, queried once with cpuid
+		InstructionSet GetSupportedInstructionSet();
+		// switches all kernels to instructionSet, limited to the supported one, returns the set in use
+		// not thread safe, call it between frames
+		InstructionSet SetInstructionSet(InstructionSet instructionSet);
+
+		// number of pixels (vertices) handled by one kernel call, 4 (SSE2) or 8 (AVX2, AVX-512)
+		int GetBlockWidth();
+		// block width of the widest instruction set, the size of every per block array
+		constexpr int MaxBlockWidth{ 8 };
+
+		// outcode bits, set for every clip space plane a vertex is outside of
+		enum ClipCode : uint32_t
+		{
+			ClipLeft = 1 << 0,
+			ClipRight = 1 << 1,
+			ClipBottom = 1 << 2,
+			ClipTop = 1 << 3,
+			ClipNear = 1 << 4,
+			ClipFar = 1 << 5,
+			ClipGuardLeft = 1 << 6,
+			ClipGuardRight = 1 << 7,
+			ClipGuardBottom = 1 << 8,
+			ClipGuardTop = 1 << 9,
+
+			ClipFrustum = ClipLeft | ClipRight | ClipBottom | ClipTop | ClipNear | ClipFar,
+			ClipGuardBand = ClipGuardLeft | ClipGuardRight | ClipGuardBottom | ClipGuardTop
+		};
+
+		// per triangle constants for the coverage kernel
+		struct CoverageSetup
+		{
+			float stepX[3]{};	// edge function increment for one pixel in x
+			float invArea{};
+			float depth[3]{};	// z / w of every vertex, linear in screenspace
+			bool acceptPositive{ true };	// accept pixels with all edge functions >= 0
+			bool acceptNegative{ true };	// accept pixels with all edge functions <= 0
+			bool depthEqual{ false };	// depthtest passes on depth == stored depth instead of depth < stored depth
+		};
+
+		struct CoverageBlock
+		{
+			alignas(32) float weights[3][MaxBlockWidth];
+			alignas(32) float depth[MaxBlockWidth];
+		};
+
+		// tests coverage, calculates the barycentric weights and interpolates the depth of a horizontal block of pixels
+		// edgeValues: edge functions evaluated in the first pixel of the block (sizeof 3!)
+		// pDepth: depthbuffer at the first pixel of the block
+		// numPixels: pixels left in the row, only the first Min(numPixels, GetBlockWidth()) are processed
+		// returns a mask with bit i set when pixel i is inside the triangle, within [0, 1] depth and passes the depthtest
+		uint32_t RasterizeBlock(const CoverageSetup& setup, const float* edgeValues, const float* pDepth, int numPixels, CoverageBlock& block);
+		// same as RasterizeBlock for blocks known to be fully inside the triangle, skips the coverage test
+		uint32_t InterpolateBlock(const CoverageSetup& setup, const float* edgeValues, const float* pDepth, int numPixels, CoverageBlock& block);
+
+		// vertex attributes a pixel shader reads, only those get interpolated
+		enum Varying : uint32_t
+		{
+			VaryingUV = 1 << 0,
+			VaryingNormal = 1 << 1,
+			VaryingTangent = 1 << 2,
+			VaryingViewDirection = 1 << 3,
+
+			VaryingAll = VaryingUV | VaryingNormal | VaryingTangent | VaryingViewDirection
+		};
+
+		// perspective correct vertex attributes are linear in screenspace after dividing them by w
+		// uv, normal, tangent, viewDirection (in that order) divided by w, followed by 1 / w itself
+		constexpr size_t NumAttributes{ 12 };
+		constexpr size_t InvWAttribute{ NumAttributes - 1 };
+		// varying every attribute belongs to, 1 / w is needed by all of them
+		constexpr uint32_t AttributeVaryings[NumAttributes]
+		{
+			VaryingUV, VaryingUV,
+			VaryingNormal, VaryingNormal, VaryingNormal,
+			VaryingTangent, VaryingTangent, VaryingTangent,
+			VaryingViewDirection, VaryingViewDirection, VaryingViewDirection,
+			VaryingAll
+		};
+
+		// plane equation of every attribute / w, set up once per triangle for the varyings of its pixel shader
+		// value at pixel p = value + ddx * (p.x - origin.x) + ddy * (p.y - origin.y)
+		struct AttributePlanes
+		{
+			float origin[2]{};	// screenspace position of vertex 0
+			float value[NumAttributes]{};
+			float ddx[NumAttributes]{};
+			float ddy[NumAttributes]{};
+		};
+
+		// SoA in- and outputs of the packet pixel shaders, lane i is pixel i of a span
+		struct ShadingBlock
+		{
+			// see InterpolateAttributes
+			alignas(32) float uv[2][MaxBlockWidth];
+			alignas(32) float normal[3][MaxBlockWidth];
+			alignas(32) float tangent[3][MaxBlockWidth];
+			alignas(32) float viewDirection[3][MaxBlockWidth];
+
+			// texture samples, fetched by the caller for the lanes it shades
+			alignas(32) float diffuse[4][MaxBlockWidth];	// rgba
+			alignas(32) float normalSample[3][MaxBlockWidth];	// rgb of the normal map
+			alignas(32) float specular[MaxBlockWidth];
+			alignas(32) float glossiness[MaxBlockWidth];
+
+			// output of the shading kernels, StorePixels clamps it like ColorRGB::MaxToOne
+			alignas(32) float color[3][MaxBlockWidth];
+		};
+
+		struct LightSetup
+		{
+			float direction[3]{};
+			float intensity{};
+		};
+
+		// evaluates the planes of varyings for the pixels (x + i, y) of a span, directions are normalized
+		// lanes outside the triangle get extrapolated values, only use the ones that are shaded
+		void InterpolateAttributes(const AttributePlanes& planes, uint32_t varyings, float x, float y, ShadingBlock& block);
+		// replaces the normal by normalSample, mapped from [0, 1] to [-1, 1] and transformed by the tangent frame
+		void ApplyNormalMap(ShadingBlock& block);
+
+		// lighting of the software pixel shaders, packet versions of ObservedArea/Diffuse/Specular/Combined
+		void ShadeObservedArea(const LightSetup& light, ShadingBlock& block);
+		void ShadeDiffuse(const LightSetup& light, ShadingBlock& block);
+		void ShadeSpecular(const LightSetup& light, ShadingBlock& block);
+		void ShadeLambertPhong(const LightSetup& light, ShadingBlock& block);
+
+		// blocked textures store TexelBlockSize x TexelBlockSize texels (one 64 byte cache line) row major per block,
+		// the blocks themselves are row major, so texels that are close in uv are close in memory in both directions
+		constexpr int TexelBlockShift{ 2 };
+		constexpr int TexelBlockSize{ 1 << TexelBlockShift };
+
+		// 32 bit texels decoded at load time (MipChain::TexelFormat), r, g, b, a in bits 0, 8, 16, 24
+		struct TextureTexels
+		{
+			const uint32_t* pTexels{ nullptr };
+			int width{};
+			int height{};
+			int blocksPerRow{};	// 0 for row linear texels (pitch == width), blocked otherwise
+		};
+
+		// what happens to uvs outside [0, 1], like D3D11_TEXTURE_ADDRESS_WRAP/CLAMP/MIRROR
+		enum class TextureAddress : uint32_t
+		{
+			Wrap, Clamp, Mirror
+		};
+
+		// point samples the texels at the uvs of a span
+		// writes the first numChannels of r, g, b, a in [0, 1] to pChannels, every lane is sampled
+		void SampleTexels(const TextureTexels& texture, TextureAddress address, const float* pU, const float* pV, int numChannels, float (*pChannels)[MaxBlockWidth]);
+		// bilinear filters the 2x2 texels around the uvs of a span, in 8 bit fixed point
+		// adds weight * the first numChannels of r, g, b, a to pChannels, every lane is sampled
+		void SampleTexelsBilinear(const TextureTexels& texture, TextureAddress address, const float* pU, const float* pV, float weight, int numChannels, float (*pChannels)[MaxBlockWidth]);
+
+		// 32 bit render target pixels with 8 bits per channel
+		struct PixelFormat
+		{
+			uint32_t channelShift[3]{};	// bit position of r, g, b in a pixel
+			uint32_t alphaMask{};	// set in every written pixel, like SDL_MapRGB does
+		};
+
+		// converts color (see ShadingBlock::color) to pixels of format and writes the lanes in mask to pPixels[0 ..]
+		void StorePixels(const PixelFormat& format, const float (*pColor)[MaxBlockWidth], uint32_t mask, uint32_t* pPixels);
+		// blends rgba over the lanes in mask of pPixels[0 ..], lerp by alpha like the Flat pixel shader
+		void BlendPixels(const PixelFormat& format, const float (*pRGBA)[MaxBlockWidth], uint32_t mask, uint32_t* pPixels);
+
+		// per mesh constants for the vertex kernel, matrices in the same row layout as Matrix::data
+		struct VertexTransform
+		{
+			float worldViewProjection[4][4]{};
+			float world[4][4]{};
+			float cameraOrigin[3]{};
+			float viewportWidth{};
+			float viewportHeight{};
+			float guardBand{};	// in units of w, see ClipGuardBand
+			bool computeViewDirection{ true };	// view direction is left zero when no pixel shader reads it
+		};
+
+		// transforms vertices [first, first + count) of the streams GetBlockWidth() at a time, first is a multiple of MaxBlockWidth
+		// writes clipspace position, uv, world normal/tangent and normalized view direction (see computeViewDirection) to pOut[first] ..
+		// and the screenspace position, depth, 1 / w and outcode to pScreen[first] ..
+		void TransformVertices(const VertexTransform& transform, const VertexStreams& vertices, size_t first, size_t count, Vertex_Out* pOut, Vertex_Screen* pScreen);
+	}
+}
@@ -0,0 +1,60 @@
+#include "pch.h"
+#include "RenderQueue.h"
+#include "Scene.h"
+#include "DataTypes.h"
+#include "ResourceManager.h"
+
+#include <bit>
+
+namespace dae
+{
+	void RenderQueue::Build(const Scene& scene)
+	{
+		const Camera& camera{ scene.GetCamera() };
+
+		m_DrawItems.clear();
+		for (const auto& pMesh : scene.m_pMeshes)
+		{
+			if (!pMesh->render)
+				continue;
+
+			//distance of the mesh origin along the view direction
+			const float viewDepth{ camera.viewMatrix.TransformPoint(pMesh->worldMatrix.GetTranslation()).z };
+			const Material& material{ ResourceManager::GetMaterial(pMesh->materialId) };
+
+			m_DrawItems.push_back({ CreateSortKey(material, viewDepth), pMesh.get() });
+		}
+
+		//stable so meshes with the same key keep the order they were added in
+		std::stable_sort(m_DrawItems.begin(), m_DrawItems.end(), [](const DrawItem& a, const DrawItem& b)
+			{
+				return a.sortKey < b.sortKey;
+			});
+	}
+
+	uint64_t RenderQueue::CreateSortKey(const Material& material, float viewDepth)
+	{
+		//the bits of a positive float sort the same way as the float itself
+		const uint64_t depthBits{ std::bit_cast<uint32_t>(Max(viewDepth, 0.f)) };
+		const uint64_t stateBits{ (uint64_t(material.shaderId & 0xFF) << 23) | GetTextureSetId(material) };
+
+		//meshes that don't write depth are blended, they need everything behind them drawn first
+		if (!material.depthWrite)
+			return (uint64_t(1) << 63) | ((~depthBits & 0xFFFFFFFF) << 31) | stateBits;
+
+		return (stateBits << 32) | depthBits;
+	}
+
+	uint32_t RenderQueue::GetTextureSetId(const Material& material)
+	{
+		//FNV-1a over the texture ids
+		uint32_t hash{ 2166136261u };
+		for (TextureID textureId : material.textures)
+		{
+			hash ^= textureId;
+			hash *= 16777619u;
+		}
+
+		return hash & 0x7FFFFF;
+	}
+}
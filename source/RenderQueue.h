@@ -0,0 +1,44 @@
+#pragma once
+#include <vector>
+#include <cstdint>
+
+namespace dae
+{
+	class Scene;
+	struct Mesh;
+	struct Material;
+
+	// sorted list of the meshes to draw this frame, shared by both rasterizers
+	// sortkey layout (most significant bit first):
+	//	opaque		| 0 | shaderId (8) | texture set (23) | view depth, front to back (32) |
+	//	transparent	| 1 | view depth, back to front (32) | shaderId (8) | texture set (23) |
+	class RenderQueue final
+	{
+	public:
+		struct DrawItem
+		{
+			uint64_t sortKey{};
+			Mesh* pMesh{ nullptr };
+		};
+
+		RenderQueue() = default;
+		~RenderQueue() = default;
+
+		RenderQueue(const RenderQueue&) = delete;
+		RenderQueue(RenderQueue&&) noexcept = delete;
+		RenderQueue& operator=(const RenderQueue&) = delete;
+		RenderQueue& operator=(RenderQueue&&) noexcept = delete;
+
+		// collects and sorts every mesh of the scene that should be rendered
+		void Build(const Scene& scene);
+
+		inline const std::vector<DrawItem>& GetDrawItems() const { return m_DrawItems; }
+
+	private:
+		static uint64_t CreateSortKey(const Material& material, float viewDepth);
+		// equal texture lists give equal ids, different lists usually don't
+		static uint32_t GetTextureSetId(const Material& material);
+
+		std::vector<DrawItem> m_DrawItems;
+	};
+}
@@ -26,6 +26,11 @@ namespace dae
 	{
 		switch (e.keysym.scancode)
 		{
+		case SDL_SCANCODE_F4:
+			CycleFilterMode();
+
+			break;
+
 		case SDL_SCANCODE_F9:
 			CycleFaceCullingMode();
 
@@ -74,4 +79,31 @@ namespace dae
 
 		PrintMessage(msg, MSG_LOGGER_SHARED, MSG_COLOR_RENDERER);
 	}
+
+	void Renderer::CycleFilterMode()
+	{
+		size_t filterMode{ static_cast<size_t>(s_Settings.filterMode) };
+		if (++filterMode == static_cast<size_t>(FilterMode::End))
+		{
+			filterMode = 0;
+		}
+		s_Settings.filterMode = static_cast<FilterMode>(filterMode);
+
+		TSTRING msg{ _T("Filter mode : ") };
+		switch (s_Settings.filterMode)
+		{
+		case FilterMode::Point:
+			msg.append(_T("Point"));
+			break;
+
+		case FilterMode::Linear:
+			msg.append(_T("Linear"));
+			break;
+
+		case FilterMode::Anisotropic:
+			msg.append(_T("Anisotropic"));
+			break;
+		}
+		PrintMessage(msg, MSG_LOGGER_SHARED, MSG_COLOR_RENDERER);
+	}
 }
@@ -1,4 +1,5 @@
 #pragma once
+#include "RenderQueue.h"
 
 struct SDL_Window;
 struct SDL_Surface;
@@ -25,13 +26,39 @@ namespace dae
 		{
 			Combined = 0, ObservedArea = 1, Diffuse = 2, Specular = 3, End = 4
 		};
+		enum class ShadingPath
+		{
+			Forward = 0, VisibilityBuffer = 1, DepthPrePass = 2, End = 3
+		};
+		// texture filtering of both rasterizers, the techniques of the effects are in the same order
+		enum class FilterMode
+		{
+			Point = 0, Linear = 1, Anisotropic = 2, End = 3
+		};
+		// what the software rasterizer does with uvs outside [0, 1], clamped by default like the software sampler always did
+		// the samplers of the effects always wrap
+		enum class TextureAddressMode
+		{
+			Wrap = 0, Clamp = 1, Mirror = 2, End = 3
+		};
+		// instruction set of the software rasterizer kernels, Auto picks the best one the cpu supports
+		enum class KernelTier
+		{
+			Auto = 0, SSE2 = 1, AVX2 = 2, AVX512 = 3, End = 4
+		};
 		struct RenderSettings
 		{
 			FaceCullingMode faceCullingMode{ FaceCullingMode::Backface };
 			ShadingMode shadingMode{ ShadingMode::Combined };
+			ShadingPath shadingPath{ ShadingPath::Forward };
+			KernelTier kernelTier{ KernelTier::Auto };
+			FilterMode filterMode{ FilterMode::Point };
+			TextureAddressMode textureAddressMode{ TextureAddressMode::Clamp };
 			bool visualizeDepthBuffer{ false };
 			bool visualizeBoundingBox{ false };
 			bool useNormalMap{ true };
+			// software color/depth buffers stored in 8x8 pixel tiles, resolved to the linear backbuffer when presenting
+			bool useTiledFramebuffer{ true };
 			bool useUniformClearColor{ false };
 			ColorRGB uniformClearColor{0.1f, 0.1f, 0.1f};
 		};
@@ -51,6 +78,7 @@ namespace dae
 	protected:
 		virtual void RenderMesh(Mesh* pMesh, const Camera& camera) const = 0;
 		virtual void CycleFaceCullingMode();
+		void CycleFilterMode();
 
 		const ColorRGB& GetClearColor() const;
 
@@ -61,6 +89,9 @@ namespace dae
 
 		ColorRGB m_ClearColor{};
 
+		// rebuilt every frame by Render
+		mutable RenderQueue m_RenderQueue{};
+
 		bool m_IsInitialized{ false };
 
 		static RenderSettings s_Settings;
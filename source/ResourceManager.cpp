@@ -13,8 +13,12 @@ namespace dae
 	{
 		auto pSurface{ IMG_Load(filepath.c_str()) };
 
-		auto textureSoftware{ std::make_unique<TextureSoftware>(pSurface) };
-		auto textureDx11{ std::make_unique<TextureDX11>(pSurface, HardwareRasterizerDX11::GetDevice()) };
+		//both rasterizers get the same mip chain, the software one keeps its own copy in the blocked layout
+		const MipChain mipChain{ pSurface };
+		auto textureSoftware{ std::make_unique<TextureSoftware>(mipChain) };
+		auto textureDx11{ std::make_unique<TextureDX11>(pSurface, mipChain, HardwareRasterizerDX11::GetDevice()) };
+		//neither texture keeps the surface
+		SDL_FreeSurface(pSurface);
 		auto texture{ std::make_pair(std::move(textureSoftware), std::move(textureDx11)) };
 
 		s_Textures.push_back(std::move(texture));
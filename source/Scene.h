@@ -37,6 +37,7 @@ namespace dae
 		friend class Renderer;
 		friend class HardwareRasterizerDX11;
 		friend class SoftwareRasterizer;
+		friend class RenderQueue;
 	};
 
 	class ExamScene : public Scene
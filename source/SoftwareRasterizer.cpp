@@ -5,22 +5,41 @@
 #include "DataTypes.h"
 #include "ResourceManager.h"
 #include "Texture.h"
+#include "TextureLayoutBenchmark.h"
 #include "ConsoleLog.h"
+#include "ThreadPool.h"
+#include "RasterizerSIMD.h"
 
 #include <array>
+#include <bit>
 
 namespace dae
 {
 	using namespace Log;
 
-	Material* SoftwareRasterizer::s_pMaterialBuffer{ nullptr };
+	thread_local Material* SoftwareRasterizer::s_pMaterialBuffer{ nullptr };
+	thread_local const SoftwareRasterizer::PixelPipeline* SoftwareRasterizer::s_pPixelPipelineBuffer{ nullptr };
 
-	struct RenderStats
+	template <SoftwareRasterizer::PixelShader Shader, bool UseNormalMap>
+	constexpr SoftwareRasterizer::PixelPipeline SoftwareRasterizer::CreatePixelPipeline()
 	{
-		size_t currentPixel{};
-	};
+		return
+		{
+			GetPixelShaderVaryings(Shader, UseNormalMap),
+			{ &SoftwareRasterizer::ShadePixels<Shader, UseNormalMap, false>, &SoftwareRasterizer::ShadePixels<Shader, UseNormalMap, true> }
+		};
+	}
 
-	static RenderStats s_RenderStats{};
+	const std::array<std::array<SoftwareRasterizer::PixelPipeline, 2>, size_t(SoftwareRasterizer::PixelShader::End)> SoftwareRasterizer::s_PixelPipelines
+	{ {
+		{ CreatePixelPipeline<PixelShader::Lambert, false>(), CreatePixelPipeline<PixelShader::Lambert, true>() },
+		{ CreatePixelPipeline<PixelShader::ObservedArea, false>(), CreatePixelPipeline<PixelShader::ObservedArea, true>() },
+		{ CreatePixelPipeline<PixelShader::Diffuse, false>(), CreatePixelPipeline<PixelShader::Diffuse, true>() },
+		{ CreatePixelPipeline<PixelShader::Specular, false>(), CreatePixelPipeline<PixelShader::Specular, true>() },
+		//no normal to map
+		{ CreatePixelPipeline<PixelShader::Flat, false>(), CreatePixelPipeline<PixelShader::Flat, false>() },
+		{ CreatePixelPipeline<PixelShader::Depth, false>(), CreatePixelPipeline<PixelShader::Depth, false>() }
+	} };
 
 	SoftwareRasterizer::SoftwareRasterizer(SDL_Window* pWindow)
 		: Renderer(pWindow)
@@ -29,20 +48,44 @@ namespace dae
 		m_pFrontBuffer = SDL_GetWindowSurface(pWindow);
 		m_pBackBuffer = SDL_CreateRGBSurface(0, m_Width, m_Height, 32, 0, 0, 0, 0);
 		m_pBackBufferPixels = (uint32_t*)m_pBackBuffer->pixels;
+		//32 bit with masks 0 is RGB888, which is what the pixel kernels write
+		SDL_assert(m_pBackBuffer->format->BytesPerPixel == 4 && m_pBackBuffer->format->Rloss == 0);
+		m_BackBufferFormat.channelShift[0] = m_pBackBuffer->format->Rshift;
+		m_BackBufferFormat.channelShift[1] = m_pBackBuffer->format->Gshift;
+		m_BackBufferFormat.channelShift[2] = m_pBackBuffer->format->Bshift;
+		m_BackBufferFormat.alphaMask = m_pBackBuffer->format->Amask;
+		m_NumCoarseBlocksX = (m_Width + s_CoarseBlockSize - 1) / s_CoarseBlockSize;
+		m_NumCoarseBlocksY = (m_Height + s_CoarseBlockSize - 1) / s_CoarseBlockSize;
+		//big enough for both layouts, the tiled one is padded to whole blocks
+		const size_t numBufferPixels{ size_t(m_NumCoarseBlocksX * m_NumCoarseBlocksY) * (s_CoarseBlockSize * s_CoarseBlockSize) };
+		m_pTiledColorBuffer = new uint32_t[numBufferPixels];
+		m_pColorBuffer = m_pBackBufferPixels;
 		//init depthbuffer
-		m_pDepthBuffer = new float[m_Width * m_Height];
+		m_pDepthBuffer = new float[numBufferPixels];
 		// set all depthbuffer elements to max float value
-		std::fill_n(m_pDepthBuffer, m_Width * m_Height, FLT_MAX);
+		std::fill_n(m_pDepthBuffer, numBufferPixels, FLT_MAX);
+		m_pVisibilityBuffer = new VisibilitySample[numBufferPixels];
 
 		m_ClearColor = ColorRGB{ 0.39f, 0.39f, 0.39f };
 
+		m_pThreadPool = std::make_unique<ThreadPool>();
+		CreateTiles();
+
+		m_CoarseDepth.resize(size_t(m_NumCoarseBlocksX * m_NumCoarseBlocksY));
+		m_CoarseDepthDirty.resize(m_CoarseDepth.size());
+		ClearCoarseDepth();
+
+		ApplyKernelTier();
+
 		TSTRING msg{ _T("\nSoftware rasterizer is initialized and ready!\n") };
 		PrintMessage(msg, MSG_LOGGER_SOFTWARERASTERIZER, MSG_COLOR_SOFTWARERASTERIZER, MSG_COLOR_SUCCESS);
 	}
 
 	SoftwareRasterizer::~SoftwareRasterizer()
 	{
+		delete[] m_pTiledColorBuffer;
 		delete[] m_pDepthBuffer;
+		delete[] m_pVisibilityBuffer;
 	}
 
 	void SoftwareRasterizer::Update(const Timer* pTimer)
@@ -89,9 +132,68 @@ namespace dae
 			PrintMessage(msg, MSG_LOGGER_SOFTWARERASTERIZER, MSG_COLOR_SOFTWARERASTERIZER);
 		}
 			break;
+
+		case SDL_SCANCODE_F12:
+		{
+			PrintTriangleStats();
+		}
+			break;
+
+		case SDL_SCANCODE_P:
+		{
+			CycleShadingPath();
+		}
+			break;
+
+		case SDL_SCANCODE_K:
+		{
+			CycleKernelTier();
+		}
+			break;
+
+		case SDL_SCANCODE_B:
+		{
+			TextureLayoutBenchmark::Run();
+		}
+			break;
+
+		case SDL_SCANCODE_L:
+		{
+			//toggle the tiled color/depth layout
+			s_Settings.useTiledFramebuffer = !s_Settings.useTiledFramebuffer;
+			TSTRING msg{ _T("Tiled framebuffer : ") + BoolToString(s_Settings.useTiledFramebuffer) };
+			PrintMessage(msg, MSG_LOGGER_SOFTWARERASTERIZER, MSG_COLOR_SOFTWARERASTERIZER);
+		}
+			break;
+
+		case SDL_SCANCODE_T:
+		{
+			CycleTextureAddressMode();
+		}
+			break;
 		}
 	}
 
+	void SoftwareRasterizer::PrintTriangleStats() const
+	{
+		TSTRING msg{ _T("Triangle stats (last frame)\n") };
+		msg.append(_T("	Submitted : ") + TO_TSTRING(m_TriangleStats.numSubmitted) + _T("\n"));
+		msg.append(_T("	Frustum culled : ") + TO_TSTRING(m_TriangleStats.numFrustumCulled) + _T("\n"));
+		msg.append(_T("	Clipped : ") + TO_TSTRING(m_TriangleStats.numClipped) + _T("\n"));
+		msg.append(_T("	Face culled : ") + TO_TSTRING(m_TriangleStats.numFaceCulled) + _T("\n"));
+		msg.append(_T("	Degenerate : ") + TO_TSTRING(m_TriangleStats.numDegenerate) + _T("\n"));
+		msg.append(_T("	Sub pixel : ") + TO_TSTRING(m_TriangleStats.numSubPixel) + _T("\n"));
+		msg.append(_T("	Rasterized : ") + TO_TSTRING(m_BinnedTriangles.size()) + _T("\n"));
+
+		size_t numDepthCulled{};
+		for (const auto& tile : m_Tiles)
+		{
+			numDepthCulled += tile.numDepthCulled;
+		}
+		msg.append(_T("	Hierarchical Z culled (per tile) : ") + TO_TSTRING(numDepthCulled));
+		PrintMessage(msg, MSG_LOGGER_SOFTWARERASTERIZER, MSG_COLOR_SOFTWARERASTERIZER);
+	}
+
 	void SoftwareRasterizer::ToggleShadingMode()
 	{
 		size_t shadingMode{ static_cast<size_t>(s_Settings.shadingMode) };
@@ -123,19 +225,144 @@ namespace dae
 		PrintMessage(msg, MSG_LOGGER_SOFTWARERASTERIZER, MSG_COLOR_SOFTWARERASTERIZER);
 	}
 
+	void SoftwareRasterizer::CycleShadingPath()
+	{
+		size_t shadingPath{ static_cast<size_t>(s_Settings.shadingPath) };
+		if (++shadingPath == static_cast<size_t>(Renderer::ShadingPath::End))
+		{
+			shadingPath = 0;
+		}
+		s_Settings.shadingPath = static_cast<Renderer::ShadingPath>(shadingPath);
+
+		TSTRING msg{ _T("Shading path : ") };
+		switch (s_Settings.shadingPath)
+		{
+		case ShadingPath::Forward:
+			msg.append(_T("Forward"));
+			break;
+
+		case ShadingPath::VisibilityBuffer:
+			msg.append(_T("Visibility Buffer"));
+			break;
+
+		case ShadingPath::DepthPrePass:
+			msg.append(_T("Depth Pre-Pass"));
+			break;
+		}
+		PrintMessage(msg, MSG_LOGGER_SOFTWARERASTERIZER, MSG_COLOR_SOFTWARERASTERIZER);
+	}
+
+	void SoftwareRasterizer::CycleKernelTier()
+	{
+		size_t kernelTier{ static_cast<size_t>(s_Settings.kernelTier) };
+		if (++kernelTier == static_cast<size_t>(Renderer::KernelTier::End))
+		{
+			kernelTier = 0;
+		}
+		s_Settings.kernelTier = static_cast<Renderer::KernelTier>(kernelTier);
+
+		const SIMD::InstructionSet instructionSet{ ApplyKernelTier() };
+
+		TSTRING msg{ _T("SIMD kernels : ") };
+		switch (s_Settings.kernelTier)
+		{
+		case KernelTier::Auto:
+			msg.append(_T("Auto"));
+			break;
+
+		case KernelTier::SSE2:
+			msg.append(_T("SSE2"));
+			break;
+
+		case KernelTier::AVX2:
+			msg.append(_T("AVX2"));
+			break;
+
+		case KernelTier::AVX512:
+			msg.append(_T("AVX-512"));
+			break;
+		}
+
+		//a forced tier the cpu can't run falls back to the best supported one
+		switch (instructionSet)
+		{
+		case SIMD::InstructionSet::SSE2:
+			msg.append(_T(" (running SSE2)"));
+			break;
+
+		case SIMD::InstructionSet::AVX2:
+			msg.append(_T(" (running AVX2)"));
+			break;
+
+		case SIMD::InstructionSet::AVX512:
+			msg.append(_T(" (running AVX-512)"));
+			break;
+		}
+		PrintMessage(msg, MSG_LOGGER_SOFTWARERASTERIZER, MSG_COLOR_SOFTWARERASTERIZER);
+	}
+
+	void SoftwareRasterizer::CycleTextureAddressMode()
+	{
+		size_t addressMode{ static_cast<size_t>(s_Settings.textureAddressMode) };
+		if (++addressMode == static_cast<size_t>(Renderer::TextureAddressMode::End))
+		{
+			addressMode = 0;
+		}
+		s_Settings.textureAddressMode = static_cast<Renderer::TextureAddressMode>(addressMode);
+
+		TSTRING msg{ _T("Texture address mode : ") };
+		switch (s_Settings.textureAddressMode)
+		{
+		case TextureAddressMode::Wrap:
+			msg.append(_T("Wrap"));
+			break;
+
+		case TextureAddressMode::Clamp:
+			msg.append(_T("Clamp"));
+			break;
+
+		case TextureAddressMode::Mirror:
+			msg.append(_T("Mirror"));
+			break;
+		}
+		PrintMessage(msg, MSG_LOGGER_SOFTWARERASTERIZER, MSG_COLOR_SOFTWARERASTERIZER);
+	}
+
+	SIMD::InstructionSet SoftwareRasterizer::ApplyKernelTier() const
+	{
+		//KernelTier is SIMD::InstructionSet shifted by Auto
+		const SIMD::InstructionSet instructionSet{ (s_Settings.kernelTier == KernelTier::Auto)
+			? SIMD::GetSupportedInstructionSet()
+			: static_cast<SIMD::InstructionSet>(static_cast<int>(s_Settings.kernelTier) - 1) };
+
+		return SIMD::SetInstructionSet(instructionSet);
+	}
+
 	void SoftwareRasterizer::Render(Scene* pScene) const
 	{
 		SDL_LockSurface(m_pBackBuffer);
 
+		//the whole frame is rendered in one layout, the clear below covers both
+		m_IsFramebufferTiled = s_Settings.useTiledFramebuffer;
+		m_pColorBuffer = (m_IsFramebufferTiled) ? m_pTiledColorBuffer : m_pBackBufferPixels;
+		const size_t numBufferPixels{ (m_IsFramebufferTiled)
+			? size_t(m_NumCoarseBlocksX * m_NumCoarseBlocksY) * (s_CoarseBlockSize * s_CoarseBlockSize)
+			: size_t(m_Width * m_Height) };
+
 		// clearColor
 		const ColorRGB& clearColor{ GetClearColor() };
 		Uint8 r{ static_cast<Uint8>(clearColor.r * 255) };
 		Uint8 g{ static_cast<Uint8>(clearColor.g * 255) };
 		Uint8 b{ static_cast<Uint8>(clearColor.b * 255) };
-		SDL_FillRect(m_pBackBuffer, NULL, SDL_MapRGB(m_pBackBuffer->format, r, g, b));
+		const Uint32 clearPixel{ SDL_MapRGB(m_pBackBuffer->format, r, g, b) };
+		if (m_IsFramebufferTiled)
+			std::fill_n(m_pTiledColorBuffer, numBufferPixels, clearPixel);
+		else
+			SDL_FillRect(m_pBackBuffer, NULL, clearPixel);
 
 		// set all depthbuffer elements to max float value
-		std::fill_n(m_pDepthBuffer, m_Width * m_Height, FLT_MAX);
+		std::fill_n(m_pDepthBuffer, numBufferPixels, FLT_MAX);
+		ClearCoarseDepth();
 
 		//temp-------//
 		Light light{};
@@ -147,15 +374,32 @@ namespace dae
 		m_pCameraBuffer = &pScene->GetCamera();
 		//-----------//
 
-		//RENDER LOGIC
-		for (auto& pMesh : pScene->m_pMeshes)
+		m_TriangleStats = {};
+		m_BinnedTriangles.clear();
+		for (auto& tile : m_Tiles)
 		{
-			if (!pMesh->render)
-				continue;
+			tile.triangles.clear();
+		}
 
-			RenderMesh(pMesh.get(), pScene->GetCamera());
+		//RENDER LOGIC
+		//transform + bin all triangles first
+		//tiles keep the submission order, opaque meshes front to back get the most out of the hierarchical z
+		m_RenderQueue.Build(*pScene);
+		VertexTransformationFunction(m_RenderQueue.GetDrawItems(), pScene->GetCamera());
+		for (const auto& drawItem : m_RenderQueue.GetDrawItems())
+		{
+			RenderMesh(drawItem.pMesh, pScene->GetCamera());
 		}
 
+		//rasterize each tile on its own thread, tiles never share pixels
+		m_pThreadPool->ParallelFor(m_Tiles.size(), [this](size_t tileIdx)
+			{
+				RenderTile(m_Tiles[tileIdx]);
+			});
+
+		if (m_IsFramebufferTiled)
+			ResolveTiledFramebuffer();
+
 		//@END
 	//Update SDL Surface
 		SDL_UnlockSurface(m_pBackBuffer);
@@ -165,9 +409,9 @@ namespace dae
 
 	void SoftwareRasterizer::RenderMesh(Mesh* pMesh, const Camera& camera) const
 	{
+		//vertices are already transformed, see VertexTransformationFunction
 		s_pMaterialBuffer = &ResourceManager::GetMaterial(pMesh->materialId);
-
-		VertexTransformationFunction(*pMesh, camera);
+		s_pPixelPipelineBuffer = &GetPixelPipeline(*s_pMaterialBuffer);
 
 		size_t step{ GetIndexStep(pMesh->primitiveTopology) };
 		size_t triangleIdx{};
@@ -179,122 +423,271 @@ namespace dae
 		}
 	}
 
-	void SoftwareRasterizer::VertexTransformationFunction(Mesh& mesh, const Camera& camera) const
+	void SoftwareRasterizer::VertexTransformationFunction(const std::vector<RenderQueue::DrawItem>& drawItems, const Camera& camera) const
 	{
-		mesh.vertices_out.clear();
-		mesh.vertices_out.resize(mesh.vertices.size());
-		const Matrix worldViewProjectionMatrix{ mesh.worldMatrix * camera.viewMatrix * camera.ProjectionMatrix };
-
-		const uint32_t numVerts{ static_cast<uint32_t>(mesh.vertices.size()) };
+		m_VertexTransforms.resize(drawItems.size());
+		m_VertexJobs.clear();
 
-		for (size_t i{}; i < numVerts; i++)
+		for (size_t meshIdx{}; meshIdx < drawItems.size(); ++meshIdx)
 		{
-			const auto& vertex{ mesh.vertices[i] };
-			Vertex_Out transformedVertex{};
+			Mesh& mesh{ *drawItems[meshIdx].pMesh };
 
-			//to viewspace
-			Vector4 vertexPos{ vertex.position.x, vertex.position.y, vertex.position.z, 1.f };
-			transformedVertex.position = worldViewProjectionMatrix.TransformPoint(vertexPos);
+			if (mesh.vertices_soa.count != mesh.vertices.size())
+			{
+				CreateVertexStreams(mesh);
+				mesh.vertices_outKey.isValid = false;
+			}
 
-			//parse unchanged data
-			transformedVertex.uv = vertex.uv;
+			//also drops the vertices clipping added last frame
+			mesh.vertices_out.resize(mesh.vertices.size());
+			mesh.vertices_screen.resize(mesh.vertices.size());
 
-			// to viewspace
-			transformedVertex.normal = mesh.worldMatrix.TransformVector(vertex.normal);
+			//view direction is the only output that is worth skipping when no pixel shader reads it
+			const uint32_t varyings{ GetPixelPipeline(ResourceManager::GetMaterial(mesh.materialId)).varyings };
+			const bool hasViewDirection{ (varyings & SIMD::VaryingViewDirection) != 0 };
 
-			transformedVertex.tangent = mesh.worldMatrix.TransformVector(vertex.tangent);
+			//static mesh + static camera, last frame's output is still correct
+			const VertexCacheKey key{ mesh.worldMatrix, camera.viewMatrix, camera.ProjectionMatrix, hasViewDirection, true };
+			if (mesh.vertices_outKey == key)
+				continue;
 
-			transformedVertex.viewDirection = (mesh.worldMatrix.TransformPoint(vertex.position)) - camera.origin;
-			transformedVertex.viewDirection.Normalize();
+			mesh.vertices_outKey = key;
+			m_VertexTransforms[meshIdx] = CreateVertexTransform(mesh, camera);
+			m_VertexTransforms[meshIdx].computeViewDirection = hasViewDirection;
 
-			mesh.vertices_out[i] = transformedVertex;
+			for (size_t first{}; first < mesh.vertices.size(); first += s_VertexChunkSize)
+			{
+				m_VertexJobs.push_back({ &mesh, meshIdx, first, Min(s_VertexChunkSize, mesh.vertices.size() - first) });
+			}
 		}
+
+		//chunks of all meshes go in one batch, small meshes don't leave threads idle
+		m_pThreadPool->ParallelFor(m_VertexJobs.size(), [this](size_t jobIdx)
+			{
+				const VertexJob& job{ m_VertexJobs[jobIdx] };
+				SIMD::TransformVertices(m_VertexTransforms[job.transformIdx], job.pMesh->vertices_soa, job.first, job.count,
+					job.pMesh->vertices_out.data(), job.pMesh->vertices_screen.data());
+			});
 	}
 
-	Vector2 SoftwareRasterizer::VertexToScreenSpace(const Vector4& vertex) const
+	SIMD::VertexTransform SoftwareRasterizer::CreateVertexTransform(const Mesh& mesh, const Camera& camera) const
 	{
+		const Matrix worldViewProjectionMatrix{ mesh.worldMatrix * camera.viewMatrix * camera.ProjectionMatrix };
+
+		SIMD::VertexTransform transform{};
+		for (int row{}; row < 4; ++row)
+		{
+			const Vector4 worldViewProjectionRow{ worldViewProjectionMatrix[row] };
+			const Vector4 worldRow{ mesh.worldMatrix[row] };
+			for (int col{}; col < 4; ++col)
+			{
+				transform.worldViewProjection[row][col] = worldViewProjectionRow[col];
+				transform.world[row][col] = worldRow[col];
+			}
+		}
+		transform.cameraOrigin[0] = camera.origin.x;
+		transform.cameraOrigin[1] = camera.origin.y;
+		transform.cameraOrigin[2] = camera.origin.z;
+		transform.viewportWidth = float(m_Width);
+		transform.viewportHeight = float(m_Height);
+		transform.guardBand = s_GuardBand;
+
+		return transform;
+	}
+
+	void SoftwareRasterizer::CreateVertexStreams(Mesh& mesh) const
+	{
+		VertexStreams& streams{ mesh.vertices_soa };
+		streams.count = mesh.vertices.size();
+
+		//padding is zero, the vertex kernel can load full blocks of any instruction set
+		constexpr size_t padding{ SIMD::MaxBlockWidth - 1 };
+		const size_t paddedCount{ (streams.count + padding) & ~padding };
+		for (auto* pStream : { &streams.positionX, &streams.positionY, &streams.positionZ, &streams.u, &streams.v,
+			&streams.normalX, &streams.normalY, &streams.normalZ, &streams.tangentX, &streams.tangentY, &streams.tangentZ })
+		{
+			pStream->assign(paddedCount, 0.f);
+		}
+
+		for (size_t i{}; i < streams.count; ++i)
+		{
+			const Vertex& vertex{ mesh.vertices[i] };
+			streams.positionX[i] = vertex.position.x;
+			streams.positionY[i] = vertex.position.y;
+			streams.positionZ[i] = vertex.position.z;
+			streams.u[i] = vertex.uv.x;
+			streams.v[i] = vertex.uv.y;
+			streams.normalX[i] = vertex.normal.x;
+			streams.normalY[i] = vertex.normal.y;
+			streams.normalZ[i] = vertex.normal.z;
+			streams.tangentX[i] = vertex.tangent.x;
+			streams.tangentY[i] = vertex.tangent.y;
+			streams.tangentZ[i] = vertex.tangent.z;
+		}
+	}
+
+	Vertex_Screen SoftwareRasterizer::VertexToScreenSpace(const Vector4& vertex) const
+	{
+		//same math as SIMD::TransformVertices
+		Vertex_Screen screenVertex{};
+		screenVertex.invW = 1.f / vertex.w;
+		screenVertex.position =
+		{
+			(vertex.x * screenVertex.invW + 1) * 0.5f * m_Width,
+			(1.f - vertex.y * screenVertex.invW) * 0.5f * m_Height
+		};
+		screenVertex.depth = vertex.z * screenVertex.invW;
+
+		return screenVertex;
+	}
+
+	TriangleVec2 SoftwareRasterizer::GetScreenSpaceTriangle(const BinnedTriangle& triangle) const
+	{
+		const auto& screenVertices{ triangle.pMesh->vertices_screen };
 		return
 		{
-			(vertex.x + 1) * 0.5f * m_Width,
-			(1.f - vertex.y) * 0.5f * m_Height
+			screenVertices[triangle.indices[0]].position,
+			screenVertices[triangle.indices[1]].position,
+			screenVertices[triangle.indices[2]].position
 		};
 	}
 
-	bool SoftwareRasterizer::IsPixelInTriangle(const TriangleVec2& verts, const Vector2& pixel, float* crossArr) const
+	bool SoftwareRasterizer::SetupEdgeFunctions(const TriangleVec2& verts, EdgeFunctions& edges) const
+	{
+		// edge i runs from vertex i + 1 to vertex i + 2
+		// E(p) = cross(p - from, to - from) = (p.x - from.x) * (to.y - from.y) - (p.y - from.y) * (to.x - from.x)
+		for (size_t i{}; i < 3; ++i)
+		{
+			const Vector2& from{ verts[(i + 1) % 3] };
+			const Vector2& to{ verts[(i + 2) % 3] };
+
+			edges.stepX[i] = to.y - from.y;
+			edges.stepY[i] = from.x - to.x;
+		}
+
+		// the sum of all edge functions is constant: the area of the parallelogram (= E2 evaluated in vertex 2)
+		const float area{ Vector2::Cross(verts[2] - verts[0], verts[1] - verts[0]) };
+		if (area == 0.f)
+			return false;
+
+		edges.invArea = 1.f / area;
+		return true;
+	}
+
+	void SoftwareRasterizer::EvaluateEdgeFunctions(const TriangleVec2& verts, const Vector2& pixel, float* edgeValues) const
 	{
 		Vector2 edge0{ verts[1] - verts[0]};
 		Vector2 vertToPixel0{ pixel - verts[0]};
-		crossArr[2] = Vector2::Cross(vertToPixel0, edge0);
+		edgeValues[2] = Vector2::Cross(vertToPixel0, edge0);
 
 		Vector2 edge1{ verts[2] - verts[1] };
 		Vector2 vertToPixel1{ pixel - verts[1] };
-		crossArr[0] = Vector2::Cross(vertToPixel1, edge1);
+		edgeValues[0] = Vector2::Cross(vertToPixel1, edge1);
 
 		Vector2 edge2{ verts[0] - verts[2] };
 		Vector2 vertToPixel2{ pixel - verts[2] };
-		crossArr[1] = Vector2::Cross(vertToPixel2, edge2);
+		edgeValues[1] = Vector2::Cross(vertToPixel2, edge2);
+	}
 
-		switch (s_Settings.faceCullingMode)
+
+	float SoftwareRasterizer::GetClipDistance(const Vector4& point, SIMD::ClipCode plane) const
+	{
+		//positive inside the plane
+		switch (plane)
 		{
-		case FaceCullingMode::Frontface:
-			return crossArr[0] >= 0.f && crossArr[1] >= 0.f && crossArr[2] >= 0.f;
-			break;
+		case SIMD::ClipNear:
+			return point.z;
 
-		case FaceCullingMode::Backface:
-			return crossArr[0] <= 0.f && crossArr[1] <= 0.f && crossArr[2] <= 0.f;
-			break;
+		case SIMD::ClipGuardLeft:
+			return point.x + s_GuardBand * point.w;
+
+		case SIMD::ClipGuardRight:
+			return s_GuardBand * point.w - point.x;
+
+		case SIMD::ClipGuardBottom:
+			return point.y + s_GuardBand * point.w;
 
-		case FaceCullingMode::None:
-			return (crossArr[0] >= 0.f && crossArr[1] >= 0.f && crossArr[2] >= 0.f)
-				|| (crossArr[0] <= 0.f && crossArr[1] <= 0.f && crossArr[2] <= 0.f);
+		case SIMD::ClipGuardTop:
+			return s_GuardBand * point.w - point.y;
+
+		default:
 			break;
 		}
 
-		return false;
+		return 0.f;
 	}
 
-	bool SoftwareRasterizer::IsPointInFrustum(const Vector4& point) const
+	size_t SoftwareRasterizer::ClipTriangle(const Triangle& triangle, ClipPolygon& polygon) const
 	{
-		return !(point.x < -1.f || point.x > 1.f 
-			|| point.y < -1.f || point.y > 1.f 
-			|| point.z < 0.f || point.z > 1.f);
-	}
+		//Sutherland-Hodgman in clip space, attributes are lerped linearly which keeps them perspective correct
+		//the near plane goes first, after that every vertex has w > 0 and the guard band planes are well defined
+		constexpr SIMD::ClipCode planes[]{ SIMD::ClipNear, SIMD::ClipGuardLeft, SIMD::ClipGuardRight, SIMD::ClipGuardBottom, SIMD::ClipGuardTop };
 
-	void SoftwareRasterizer::PerspectiveDivide(Triangle& triangle) const
-	{
-		for (size_t i{}; i < triangle.Size(); i++)
+		ClipPolygon buffer{};
+		ClipPolygon* pIn{ &polygon };
+		ClipPolygon* pOut{ &buffer };
+
+		polygon[0] = triangle[0];
+		polygon[1] = triangle[1];
+		polygon[2] = triangle[2];
+		size_t numVertices{ 3 };
+
+		for (SIMD::ClipCode plane : planes)
 		{
-			float invW{ 1.f / triangle[i].position.w };
+			std::array<float, s_MaxClipVertices> distances{};
+			bool isClipped{ false };
+			for (size_t i{}; i < numVertices; ++i)
+			{
+				distances[i] = GetClipDistance((*pIn)[i].position, plane);
+				isClipped |= distances[i] < 0.f;
+			}
 
-			triangle[i].position.x *= invW;
-			triangle[i].position.y *= invW;
-			triangle[i].position.z *= invW;
-		}
-	}
+			if (!isClipped)
+				continue;
 
-	void SoftwareRasterizer::GetBoundingBoxPixelsFromTriangle(const TriangleVec2& triangle, int& minX, int& minY, int& maxX, int& maxY) const
-	{
-		minX = int(triangle[0].x);
-		minY = int(triangle[0].y);
-		maxX = minX;
-		maxY = minY;
+			size_t numOut{};
+			for (size_t i{}; i < numVertices; ++i)
+			{
+				const size_t next{ (i + 1) % numVertices };
+				const bool isInside{ distances[i] >= 0.f };
+
+				if (isInside)
+					(*pOut)[numOut++] = (*pIn)[i];
+
+				//edge crosses the plane
+				if (isInside != (distances[next] >= 0.f))
+				{
+					const float t{ distances[i] / (distances[i] - distances[next]) };
+					(*pOut)[numOut++] = LerpVertex((*pIn)[i], (*pIn)[next], t);
+				}
+			}
 
-		minX = Min(minX, int(triangle[1].x));
-		minY = Min(minY, int(triangle[1].y));
+			std::swap(pIn, pOut);
+			numVertices = numOut;
 
-		maxX = Max(maxX, int(triangle[1].x));
-		maxY = Max(maxY, int(triangle[1].y));
+			if (numVertices < 3)
+				return 0;
+		}
 
-		minX = Min(minX, int(triangle[2].x));
-		minY = Min(minY, int(triangle[2].y));
+		if (pIn != &polygon)
+			polygon = *pIn;
 
-		maxX = Max(maxX, int(triangle[2].x));
-		maxY = Max(maxY, int(triangle[2].y));
+		return numVertices;
+	}
 
-		minX = Clamp(minX - 1, 0, m_Width - 1);
-		minY = Clamp(minY - 1, 0, m_Height - 1);
-		maxX = Clamp(maxX + 1, 0, m_Width - 1);
-		maxY = Clamp(maxY + 1, 0, m_Height - 1);
+	void SoftwareRasterizer::GetBoundingBoxPixelsFromTriangle(const TriangleVec2& triangle, int& minX, int& minY, int& maxX, int& maxY) const
+	{
+		const float minVertX{ Min(triangle[0].x, Min(triangle[1].x, triangle[2].x)) };
+		const float minVertY{ Min(triangle[0].y, Min(triangle[1].y, triangle[2].y)) };
+		const float maxVertX{ Max(triangle[0].x, Max(triangle[1].x, triangle[2].x)) };
+		const float maxVertY{ Max(triangle[0].y, Max(triangle[1].y, triangle[2].y)) };
+
+		//pixels are sampled at their integer coordinates, only the ones between the vertices can be covered
+		//max is exclusive
+		minX = int(Clamp(ceilf(minVertX), 0.f, float(m_Width)));
+		minY = int(Clamp(ceilf(minVertY), 0.f, float(m_Height)));
+		maxX = int(Clamp(floorf(maxVertX) + 1.f, 0.f, float(m_Width)));
+		maxY = int(Clamp(floorf(maxVertY) + 1.f, 0.f, float(m_Height)));
 	}
 
 	void SoftwareRasterizer::GetTriangleIndices(const Mesh& mesh, size_t triangleIndex, size_t& i0, size_t& i1, size_t& i2) const
@@ -348,303 +741,766 @@ namespace dae
 		size_t i0{}, i1{}, i2{};
 		GetTriangleIndices(*pMesh, triangleIndex, i0, i1, i2);
 
-		Triangle triangle{ pMesh->vertices_out[i0], pMesh->vertices_out[i1], pMesh->vertices_out[i2] };
+		++m_TriangleStats.numSubmitted;
 
-		PerspectiveDivide(triangle);
+		const uint32_t outcode0{ pMesh->vertices_screen[i0].outcode };
+		const uint32_t outcode1{ pMesh->vertices_screen[i1].outcode };
+		const uint32_t outcode2{ pMesh->vertices_screen[i2].outcode };
 
-		if (!IsPointInFrustum(triangle[0].position)
-			|| !IsPointInFrustum(triangle[1].position)
-			|| !IsPointInFrustum(triangle[2].position))
+		//all vertices outside the same plane
+		if ((outcode0 & outcode1 & outcode2 & SIMD::ClipFrustum) != 0)
+		{
+			++m_TriangleStats.numFrustumCulled;
+			return;
+		}
+
+		//crossing the near plane or leaving the guard band needs geometric clipping
+		//everything else is scissored by the bounding box, the far plane is handled by the per pixel depth range test
+		if (((outcode0 | outcode1 | outcode2) & (SIMD::ClipNear | SIMD::ClipGuardBand)) == 0)
+		{
+			SetupTriangle(pMesh, { uint32_t(i0), uint32_t(i1), uint32_t(i2) });
 			return;
+		}
 
-		RenderTriangle(triangle);
+		++m_TriangleStats.numClipped;
+
+		const Triangle triangle{ pMesh->vertices_out[i0], pMesh->vertices_out[i1], pMesh->vertices_out[i2] };
+		ClipPolygon polygon{};
+		const size_t numVertices{ ClipTriangle(triangle, polygon) };
+
+		//new vertices live in the mesh until the next vertex stage
+		const uint32_t firstVertex{ static_cast<uint32_t>(pMesh->vertices_out.size()) };
+		for (size_t i{}; i < numVertices; ++i)
+		{
+			pMesh->vertices_out.push_back(polygon[i]);
+			pMesh->vertices_screen.push_back(VertexToScreenSpace(polygon[i].position));
+		}
+
+		//triangle fan keeps the winding order
+		for (uint32_t i{ 1 }; i + 1 < numVertices; ++i)
+		{
+			SetupTriangle(pMesh, { firstVertex, firstVertex + i, firstVertex + i + 1 });
+		}
 	}
 
-	Vertex_Out SoftwareRasterizer::LerpVertex(const Vertex_Out& triangle0, const Vertex_Out& triangle1, float t) const
+	void SoftwareRasterizer::SetupTriangle(Mesh* pMesh, const std::array<uint32_t, 3>& indices) const
 	{
-		Vertex_Out lerpedVertex{};
-		lerpedVertex.position = Vector4::Lerp(triangle0.position, triangle1.position, t);
-		lerpedVertex.normal = Vector3::Lerp(triangle0.normal, triangle1.normal, t);
-		lerpedVertex.tangent = Vector3::Lerp(triangle0.tangent, triangle1.tangent, t);
-		lerpedVertex.uv = Vector2::Lerp(triangle0.uv, triangle1.uv, t);
-		lerpedVertex.viewDirection = Vector3::Lerp(triangle0.viewDirection, triangle1.viewDirection, t);
-		//lerpedVertex.color = ColorRGB::Lerp(triangle0.color, triangle1.color, t);
+		//triangle setup, everything rejected here never reaches the rasterizer
+		BinnedTriangle binnedTriangle{};
+		binnedTriangle.pMesh = pMesh;
+		binnedTriangle.indices = indices;
+		binnedTriangle.pMaterial = s_pMaterialBuffer;
 
-		return lerpedVertex;
+		const TriangleVec2 screenSpace{ GetScreenSpaceTriangle(binnedTriangle) };
+
+		if (!SetupEdgeFunctions(screenSpace, binnedTriangle.edges))
+		{
+			++m_TriangleStats.numDegenerate;
+			return;
+		}
+
+		if (IsFaceCulled(binnedTriangle.edges))
+		{
+			++m_TriangleStats.numFaceCulled;
+			return;
+		}
+
+		//find pixelrange to test overlap
+		GetBoundingBoxPixelsFromTriangle(screenSpace,
+			binnedTriangle.minX, binnedTriangle.minY, binnedTriangle.maxX, binnedTriangle.maxY);
+
+		//no pixel center inside the bounding box
+		if (binnedTriangle.minX >= binnedTriangle.maxX || binnedTriangle.minY >= binnedTriangle.maxY)
+		{
+			++m_TriangleStats.numSubPixel;
+			return;
+		}
+
+		//interpolated depth can round a few ulps past the vertices, keep a margin so the hierarchical z test stays conservative
+		const auto& screenVertices{ pMesh->vertices_screen };
+		binnedTriangle.minDepth = Min(screenVertices[indices[0]].depth,
+			Min(screenVertices[indices[1]].depth, screenVertices[indices[2]].depth)) * s_CoarseDepthMargin;
+
+		binnedTriangle.pPipeline = s_pPixelPipelineBuffer;
+		SetupAttributePlanes(binnedTriangle, binnedTriangle.attributes);
+
+		BinTriangle(std::move(binnedTriangle));
 	}
 
-	Uint32 SoftwareRasterizer::PixelShading(const Vertex_Out& vertex) const
+	void SoftwareRasterizer::SetupAttributePlanes(const BinnedTriangle& triangle, SIMD::AttributePlanes& planes) const
 	{
-		assert(s_pMaterialBuffer && "materialbuffer is nullptr!\n");
+		//barycentric weight i = E_i(p) * invArea, so stepping one pixel changes it by step_i * invArea
+		//attribute / w = sum of weight i * (attribute_i / w_i), its gradient is the same sum over the steps
+		std::array<std::array<float, SIMD::NumAttributes>, 3> vertexValues{};
+		for (size_t i{}; i < 3; ++i)
+		{
+			const Vertex_Out& vertex{ triangle.pMesh->vertices_out[triangle.indices[i]] };
+			const float invW{ triangle.pMesh->vertices_screen[triangle.indices[i]].invW };
 
-		ColorRGB colorOut{};
+			vertexValues[i] =
+			{
+				vertex.uv.x * invW, vertex.uv.y * invW,
+				vertex.normal.x * invW, vertex.normal.y * invW, vertex.normal.z * invW,
+				vertex.tangent.x * invW, vertex.tangent.y * invW, vertex.tangent.z * invW,
+				vertex.viewDirection.x * invW, vertex.viewDirection.y * invW, vertex.viewDirection.z * invW,
+				invW
+			};
+		}
 
-		switch (s_pMaterialBuffer->shaderId)
+		const EdgeFunctions& edges{ triangle.edges };
+		const Vector2& origin{ triangle.pMesh->vertices_screen[triangle.indices[0]].position };
+		planes.origin[0] = origin.x;
+		planes.origin[1] = origin.y;
+		for (size_t a{}; a < SIMD::NumAttributes; ++a)
 		{
-		case 0:
-			colorOut = VehiclePixelShader(vertex);
-			break;
-		
-		case 1:
-			colorOut = FlatPixelShader(vertex);
-			break;
+			if ((SIMD::AttributeVaryings[a] & triangle.pPipeline->varyings) == 0)
+				continue;
+
+			planes.value[a] = vertexValues[0][a];
+			planes.ddx[a] = (edges.stepX[0] * vertexValues[0][a] + edges.stepX[1] * vertexValues[1][a] + edges.stepX[2] * vertexValues[2][a]) * edges.invArea;
+			planes.ddy[a] = (edges.stepY[0] * vertexValues[0][a] + edges.stepY[1] * vertexValues[1][a] + edges.stepY[2] * vertexValues[2][a]) * edges.invArea;
 		}
+	}
 
-		//Update Color in Buffer
-		colorOut.MaxToOne();
+	bool SoftwareRasterizer::IsFaceCulled(const EdgeFunctions& edges) const
+	{
+		//the sign of the area gives the winding order in screenspace, positive is facing away from the camera
+		const bool isBackFacing{ edges.invArea > 0.f };
 
-		return SDL_MapRGB(m_pBackBuffer->format,
-			static_cast<uint8_t>(colorOut.r * 255),
-			static_cast<uint8_t>(colorOut.g * 255),
-			static_cast<uint8_t>(colorOut.b * 255));
+		switch (s_Settings.faceCullingMode)
+		{
+		case FaceCullingMode::Backface:
+			return isBackFacing;
+
+		case FaceCullingMode::Frontface:
+			return !isBackFacing;
+		}
+
+		return false;
 	}
 
-	Vector3 SoftwareRasterizer::SampleNormalMap(const Vector3& normal, const Vector3& tangent, const Vector2& uv, const TextureSoftware& normalMap) const
+	void SoftwareRasterizer::CreateTiles()
 	{
-		const Vector3 binormal = Vector3::Cross(normal, tangent).Normalized();
-		const Matrix tbn = Matrix{ tangent ,binormal, normal, Vector3::Zero };
+		const int numTilesX{ (m_Width + s_TileSize - 1) / s_TileSize };
+		const int numTilesY{ (m_Height + s_TileSize - 1) / s_TileSize };
 
-		const ColorRGB normalColor{ (2 * normalMap.Sample(uv)) - ColorRGB{1,1,1} };
-		const Vector3 normalSample{ normalColor.r,normalColor.g,normalColor.b };
-		return tbn.TransformVector(normalSample).Normalized();
+		m_Tiles.resize(size_t(numTilesX * numTilesY));
+		for (int y{}; y < numTilesY; ++y)
+		{
+			for (int x{}; x < numTilesX; ++x)
+			{
+				Tile& tile{ m_Tiles[size_t(x + y * numTilesX)] };
+				tile.minX = x * s_TileSize;
+				tile.minY = y * s_TileSize;
+				tile.maxX = Min(tile.minX + s_TileSize, m_Width);
+				tile.maxY = Min(tile.minY + s_TileSize, m_Height);
+			}
+		}
 	}
 
-	ColorRGB SoftwareRasterizer::VehiclePixelShader(const Vertex_Out& vertex) const
+	void SoftwareRasterizer::BinTriangle(BinnedTriangle&& binnedTriangle) const
 	{
-		switch (s_Settings.shadingMode)
+		const uint32_t triangleIdx{ static_cast<uint32_t>(m_BinnedTriangles.size()) };
+		m_BinnedTriangles.push_back(std::move(binnedTriangle));
+
+		//add the triangle to every tile its bounding box touches
+		const int numTilesX{ (m_Width + s_TileSize - 1) / s_TileSize };
+		const int minTileX{ m_BinnedTriangles.back().minX / s_TileSize };
+		const int minTileY{ m_BinnedTriangles.back().minY / s_TileSize };
+		const int maxTileX{ (m_BinnedTriangles.back().maxX - 1) / s_TileSize };
+		const int maxTileY{ (m_BinnedTriangles.back().maxY - 1) / s_TileSize };
+
+		for (int tileY{ minTileY }; tileY <= maxTileY; ++tileY)
 		{
-		case ShadingMode::Combined:
-			return LambertPixelShader(vertex);
-			break;
+			for (int tileX{ minTileX }; tileX <= maxTileX; ++tileX)
+			{
+				m_Tiles[size_t(tileX + tileY * numTilesX)].triangles.push_back(triangleIdx);
+			}
+		}
+	}
 
-		case ShadingMode::ObservedArea:
-			return ObservedAreaPixelShader(vertex);
-			break;
+	void SoftwareRasterizer::ClearCoarseDepth() const
+	{
+		std::fill(m_CoarseDepth.begin(), m_CoarseDepth.end(), FLT_MAX);
+		std::fill(m_CoarseDepthDirty.begin(), m_CoarseDepthDirty.end(), uint8_t(0));
 
-		case ShadingMode::Diffuse:
-			return DiffusePixelShader(vertex);
-			break;
+		for (auto& tile : m_Tiles)
+		{
+			tile.maxDepth = FLT_MAX;
+			tile.isDepthDirty = false;
+			tile.numDepthCulled = 0;
+		}
+	}
 
-		case ShadingMode::Specular:
-			return SpecularPixelShader(vertex);
-			break;
+	float SoftwareRasterizer::GetCoarseDepth(size_t blockIdx) const
+	{
+		if (m_CoarseDepthDirty[blockIdx])
+		{
+			const int blockX{ int(blockIdx % m_NumCoarseBlocksX) * s_CoarseBlockSize };
+			const int blockY{ int(blockIdx / m_NumCoarseBlocksX) * s_CoarseBlockSize };
+			const int endX{ Min(blockX + s_CoarseBlockSize, m_Width) };
+			const int endY{ Min(blockY + s_CoarseBlockSize, m_Height) };
+
+			float maxDepth{ 0.f };
+			for (int py{ blockY }; py < endY; ++py)
+			{
+				//a row of a block is contiguous in both layouts
+				const float* pDepth{ m_pDepthBuffer + GetPixelIndex(blockX, py) };
+				for (int i{}; i < endX - blockX; ++i)
+				{
+					maxDepth = Max(maxDepth, pDepth[i]);
+				}
+			}
+
+			m_CoarseDepth[blockIdx] = maxDepth;
+			m_CoarseDepthDirty[blockIdx] = 0;
 		}
-		return ColorRGB();
+
+		return m_CoarseDepth[blockIdx];
 	}
 
-	ColorRGB SoftwareRasterizer::LambertPixelShader(const Vertex_Out& vertex) const
+	float SoftwareRasterizer::GetTileMaxDepth(Tile& tile) const
 	{
-		Vector3 viewDir{ (vertex.viewDirection) };
+		if (tile.isDepthDirty)
+		{
+			const int firstBlockX{ tile.minX / s_CoarseBlockSize };
+			const int firstBlockY{ tile.minY / s_CoarseBlockSize };
+			const int endBlockX{ (tile.maxX + s_CoarseBlockSize - 1) / s_CoarseBlockSize };
+			const int endBlockY{ (tile.maxY + s_CoarseBlockSize - 1) / s_CoarseBlockSize };
+
+			float maxDepth{ 0.f };
+			for (int blockY{ firstBlockY }; blockY < endBlockY; ++blockY)
+			{
+				for (int blockX{ firstBlockX }; blockX < endBlockX; ++blockX)
+				{
+					maxDepth = Max(maxDepth, GetCoarseDepth(size_t(blockX + blockY * m_NumCoarseBlocksX)));
+				}
+			}
+
+			tile.maxDepth = maxDepth;
+			tile.isDepthDirty = false;
+		}
 
-		//get textures
-		auto& diffuseMap{ ResourceManager::GetTexture(s_pMaterialBuffer->textures[0]) };
-		auto& normalMap{ ResourceManager::GetTexture(s_pMaterialBuffer->textures[1]) };
-		auto& specularMap{ ResourceManager::GetTexture(s_pMaterialBuffer->textures[2]) };
-		auto& glossinessMap{ ResourceManager::GetTexture(s_pMaterialBuffer->textures[3]) };
+		return tile.maxDepth;
+	}
 
-		ColorRGB colorOut{};
+	void SoftwareRasterizer::RenderTile(Tile& tile) const
+	{
+		if (s_Settings.shadingPath == ShadingPath::VisibilityBuffer && !s_Settings.visualizeBoundingBox)
+		{
+			FillPixels(m_pVisibilityBuffer, tile.minX, tile.minY, tile.maxX, tile.maxY, VisibilitySample{});
 
-		//normal
-		Vector3 normal{(s_Settings.useNormalMap) 
-			? SampleNormalMap(vertex.normal, vertex.tangent, vertex.uv, normalMap)
-			: vertex.normal};
+			//opaque triangles only store what is visible, each pixel gets shaded once
+			RenderTriangles(tile, RasterPass::Visibility);
+			ResolveVisibility(tile);
 
-		//shading
-		float observedArea{ Max(Vector3::Dot(normal, -m_pLightBuffer->direction), 0.f) };
+			//blended triangles need what is behind them, shade them on top
+			RenderTriangles(tile, RasterPass::Transparent);
+			return;
+		}
 
-		ColorRGB baseColor{ diffuseMap.Sample(vertex.uv) };
-		ColorRGB ambient{ 0.025f, 0.025f, 0.025f };
-		ColorRGB diffuse{ Lambert(1.f, baseColor) };
-		float spec{ specularMap.Sample(vertex.uv).r };
-		float glossiness{ 25.f };
-		float exp{ glossinessMap.Sample(vertex.uv).r * glossiness };
-		ColorRGB specular{ spec * Phong(1.f, exp, -m_pLightBuffer->direction, viewDir, normal) };
+		if (s_Settings.shadingPath == ShadingPath::DepthPrePass && !s_Settings.visualizeBoundingBox)
+		{
+			//the final depth of every opaque pixel is known before anything gets shaded,
+			//the shading pass only runs the pixelshader where the depth matches
+			RenderTriangles(tile, RasterPass::Depth);
+			RenderTriangles(tile, RasterPass::Opaque);
 
-		colorOut = ambient + specular + diffuse * observedArea * m_pLightBuffer->intensity;
+			RenderTriangles(tile, RasterPass::Transparent);
+			return;
+		}
 
-		return colorOut;
+		RenderTriangles(tile, RasterPass::Forward);
 	}
 
-	ColorRGB SoftwareRasterizer::FlatPixelShader(const Vertex_Out& vertex) const
+	void SoftwareRasterizer::RenderTriangles(Tile& tile, RasterPass pass) const
 	{
-		//get textures
-		auto& diffuseMap{ ResourceManager::GetTexture(s_pMaterialBuffer->textures[0]) };
+		for (uint32_t triangleIdx : tile.triangles)
+		{
+			const BinnedTriangle& binnedTriangle{ m_BinnedTriangles[triangleIdx] };
 
-		ColorRGBA colorSample{ diffuseMap.SampleRGBA(vertex.uv)};
-		Uint8 r{}, g{}, b{};
-		SDL_GetRGB(m_pBackBufferPixels[s_RenderStats.currentPixel], m_pBackBuffer->format, &r, &g, &b);
-		constexpr const float colorDivider{ 1.f / 255.f };
-		ColorRGB backBufferColor{r * colorDivider, g * colorDivider, b * colorDivider };
+			const bool isOpaquePass{ pass == RasterPass::Visibility || pass == RasterPass::Depth || pass == RasterPass::Opaque };
+			if ((isOpaquePass && !binnedTriangle.pMaterial->depthWrite)
+				|| (pass == RasterPass::Transparent && binnedTriangle.pMaterial->depthWrite))
+				continue;
 
-		if (colorSample.a <= 0.0001f)
-			return backBufferColor;
+			//depthtest is less, a triangle that is nowhere closer than the farthest pixel in the tile is fully hidden
+			if (binnedTriangle.minDepth >= GetTileMaxDepth(tile))
+			{
+				++tile.numDepthCulled;
+				continue;
+			}
 
-		ColorRGB colorOut{ ColorRGB::Lerp(backBufferColor, colorSample.Rgb(), colorSample.a)};
-		//ColorRGB colorOut{ (1.f - colorSample.a) * backBufferColor
-		//	+ colorSample.a * colorSample.Rgb() };
+			s_pMaterialBuffer = binnedTriangle.pMaterial;
 
-		return colorOut;
+			RenderTriangle(triangleIdx, tile, pass);
+		}
 	}
 
-	ColorRGB SoftwareRasterizer::ObservedAreaPixelShader(const Vertex_Out& vertex) const
+	void SoftwareRasterizer::ResolveVisibility(const Tile& tile) const
 	{
-		//normal
-		auto& normalMap{ ResourceManager::GetTexture(s_pMaterialBuffer->textures[1]) };
-		Vector3 normal{ (s_Settings.useNormalMap)
-			? SampleNormalMap(vertex.normal, vertex.tangent, vertex.uv, normalMap)
-			: vertex.normal };
+		const int blockWidth{ SIMD::GetBlockWidth() };
+		SIMD::CoverageBlock pixels{};
+		for (int py{ tile.minY }; py < tile.maxY; ++py)
+		{
+			for (int px{ tile.minX }; px < tile.maxX; px += blockWidth)
+			{
+				const int numPixels{ Min(blockWidth, tile.maxX - px) };
+				const size_t firstPixel{ GetPixelIndex(px, py) };
+				const VisibilitySample* pSamples{ m_pVisibilityBuffer + firstPixel };
 
-		float oa{ Max(Vector3::Dot(normal, -m_pLightBuffer->direction), 0.f) };
-		return { oa, oa, oa };
+				uint32_t remaining{};
+				for (int i{}; i < numPixels; ++i)
+				{
+					pixels.depth[i] = m_pDepthBuffer[firstPixel + i];
+					if (pSamples[i].triangleIdx != s_InvalidTriangle)
+						remaining |= 1u << i;
+				}
+
+				//pixels of the span that show the same triangle are shaded as one packet
+				while (remaining != 0)
+				{
+					const uint32_t triangleIdx{ pSamples[std::countr_zero(remaining)].triangleIdx };
+					uint32_t mask{};
+					for (uint32_t lanes{ remaining }; lanes != 0; lanes &= lanes - 1)
+					{
+						const int i{ std::countr_zero(lanes) };
+						if (pSamples[i].triangleIdx == triangleIdx)
+							mask |= 1u << i;
+					}
+					remaining &= ~mask;
+
+					const BinnedTriangle& binnedTriangle{ m_BinnedTriangles[triangleIdx] };
+					s_pMaterialBuffer = binnedTriangle.pMaterial;
+					(this->*binnedTriangle.pPipeline->pShadePixels[false])(binnedTriangle, pixels, mask, px, py);
+				}
+			}
+		}
 	}
 
-	ColorRGB SoftwareRasterizer::DiffusePixelShader(const Vertex_Out& vertex) const
+	Vertex_Out SoftwareRasterizer::LerpVertex(const Vertex_Out& triangle0, const Vertex_Out& triangle1, float t) const
 	{
-		auto& diffuseMap{ ResourceManager::GetTexture(s_pMaterialBuffer->textures[0]) };
-		auto& normalMap{ ResourceManager::GetTexture(s_pMaterialBuffer->textures[1]) };
-		Vector3 normal{ (s_Settings.useNormalMap)
-			? SampleNormalMap(vertex.normal, vertex.tangent, vertex.uv, normalMap)
-			: vertex.normal };
-		float oa{ Max(Vector3::Dot(normal, -m_pLightBuffer->direction), 0.f) };
-		ColorRGB baseColor{ diffuseMap.Sample(vertex.uv) };
-		return Lambert(1.f, baseColor) * oa * m_pLightBuffer->intensity;
+		Vertex_Out lerpedVertex{};
+		lerpedVertex.position = Vector4::Lerp(triangle0.position, triangle1.position, t);
+		lerpedVertex.normal = Vector3::Lerp(triangle0.normal, triangle1.normal, t);
+		lerpedVertex.tangent = Vector3::Lerp(triangle0.tangent, triangle1.tangent, t);
+		lerpedVertex.uv = Vector2::Lerp(triangle0.uv, triangle1.uv, t);
+		lerpedVertex.viewDirection = Vector3::Lerp(triangle0.viewDirection, triangle1.viewDirection, t);
+		//lerpedVertex.color = ColorRGB::Lerp(triangle0.color, triangle1.color, t);
+
+		return lerpedVertex;
 	}
 
-	ColorRGB SoftwareRasterizer::SpecularPixelShader(const Vertex_Out& vertex) const
+	const SoftwareRasterizer::PixelPipeline& SoftwareRasterizer::GetPixelPipeline(const Material& material) const
 	{
-		auto& normalMap{ ResourceManager::GetTexture(s_pMaterialBuffer->textures[1]) };
-		auto& specularMap{ ResourceManager::GetTexture(s_pMaterialBuffer->textures[2]) };
-		auto& glossinessMap{ ResourceManager::GetTexture(s_pMaterialBuffer->textures[3]) };
+		//every setting the pixel stage depends on is resolved here once per draw instead of once per pixel
+		if (s_Settings.visualizeDepthBuffer)
+			return s_PixelPipelines[size_t(PixelShader::Depth)][0];
+
+		PixelShader shader{ PixelShader::Flat };
+		switch (material.shaderId)
+		{
+		case 0:
+			switch (s_Settings.shadingMode)
+			{
+			case ShadingMode::Combined:
+				shader = PixelShader::Lambert;
+				break;
+
+			case ShadingMode::ObservedArea:
+				shader = PixelShader::ObservedArea;
+				break;
 
-		//normal
-		Vector3 normal{ (s_Settings.useNormalMap)
-			? SampleNormalMap(vertex.normal, vertex.tangent, vertex.uv, normalMap)
-			: vertex.normal };
+			case ShadingMode::Diffuse:
+				shader = PixelShader::Diffuse;
+				break;
+
+			case ShadingMode::Specular:
+				shader = PixelShader::Specular;
+				break;
+			}
+			break;
+
+		case 1:
+			shader = PixelShader::Flat;
+			break;
+		}
 
-		float spec{ specularMap.Sample(vertex.uv).r };
-		float glossiness{ 25.f };
-		float exp{ glossinessMap.Sample(vertex.uv).r * glossiness };
-		return { spec * Phong(1.f, exp, -m_pLightBuffer->direction, vertex.viewDirection, normal) };
+		return s_PixelPipelines[size_t(shader)][s_Settings.useNormalMap];
 	}
 
-	void SoftwareRasterizer::RenderTriangle(Triangle& triangle) const
+	void SoftwareRasterizer::RenderTriangle(uint32_t triangleIdx, Tile& tile, RasterPass pass) const
 	{
-		const float invPosW0{ 1.f / triangle[0].position.w };
-		const float invPosW1{ 1.f / triangle[1].position.w };
-		const float invPosW2{ 1.f / triangle[2].position.w };
+		const BinnedTriangle& binnedTriangle{ m_BinnedTriangles[triangleIdx] };
+		const auto& screenVertices{ binnedTriangle.pMesh->vertices_screen };
+		const EdgeFunctions& edges{ binnedTriangle.edges };
 
-		TriangleVec2 triangleScreenSpace
+		//only touch the pixels owned by this tile
+		const int minX{ Max(binnedTriangle.minX, tile.minX) };
+		const int minY{ Max(binnedTriangle.minY, tile.minY) };
+		const int maxX{ Min(binnedTriangle.maxX, tile.maxX) };
+		const int maxY{ Min(binnedTriangle.maxY, tile.maxY) };
+
+		if (s_Settings.visualizeBoundingBox)
 		{
-			VertexToScreenSpace(triangle[0].position),
-			VertexToScreenSpace(triangle[1].position),
-			VertexToScreenSpace(triangle[2].position)
-		};
+			FillPixels(m_pColorBuffer, minX, minY, maxX, maxY, uint32_t(RGB(255, 255, 255)));
+			return;
+		}
 
-		//find pixelrange to test overlap
-		int minX{}, minY{}, maxX{}, maxY{};
-		GetBoundingBoxPixelsFromTriangle(triangleScreenSpace, minX, minY, maxX, maxY);
+		//inside the triangle all edge functions have the same sign as the area
+		//culled orientations never get here, see IsFaceCulled
+		const bool isPositive{ edges.invArea > 0.f };
 
-		for (int px{ minX }; px < maxX; ++px)
+		SIMD::CoverageSetup coverage{};
+		coverage.invArea = edges.invArea;
+		for (size_t i{}; i < 3; ++i)
 		{
-			for (int py{ minY }; py < maxY; ++py)
-			{
-				s_RenderStats.currentPixel = size_t(px + (py * m_Width));
+			coverage.stepX[i] = edges.stepX[i];
+			coverage.depth[i] = screenVertices[binnedTriangle.indices[i]].depth;
+		}
+		coverage.acceptPositive = isPositive;
+		coverage.acceptNegative = !isPositive;
+		coverage.depthEqual = pass == RasterPass::Opaque;
+
+		//depth is linear in screenspace, the smallest value over a block is the nearest depth the triangle can have in it
+		float depthStepX{}, depthStepY{};
+		for (size_t i{}; i < 3; ++i)
+		{
+			depthStepX += edges.stepX[i] * edges.invArea * coverage.depth[i];
+			depthStepY += edges.stepY[i] * edges.invArea * coverage.depth[i];
+		}
+		const float minDepthOffset{ Min(depthStepX * (s_CoarseBlockSize - 1), 0.f) + Min(depthStepY * (s_CoarseBlockSize - 1), 0.f) };
+		//the shading pass after a depth pre-pass would only write the same depth again
+		const bool isDepthWrite{ binnedTriangle.pMaterial->depthWrite && pass != RasterPass::Opaque };
+		const ShadePixelsFunction pShadePixels{ binnedTriangle.pPipeline->pShadePixels[isDepthWrite] };
+
+		//range of every edge function over a block, relative to its top left pixel
+		//flipped to the triangle's orientation so inside is always >= 0
+		const float orientation{ isPositive ? 1.f : -1.f };
+		float minBlockOffset[3]{}, maxBlockOffset[3]{};
+		float blockStepX[3]{}, blockStepY[3]{}, spanStepX[3]{};
+		const int blockWidth{ SIMD::GetBlockWidth() };
+		for (size_t i{}; i < 3; ++i)
+		{
+			const float offsetX{ orientation * edges.stepX[i] * (s_CoarseBlockSize - 1) };
+			const float offsetY{ orientation * edges.stepY[i] * (s_CoarseBlockSize - 1) };
+			minBlockOffset[i] = Min(offsetX, 0.f) + Min(offsetY, 0.f);
+			maxBlockOffset[i] = Max(offsetX, 0.f) + Max(offsetY, 0.f);
+
+			blockStepX[i] = edges.stepX[i] * s_CoarseBlockSize;
+			blockStepY[i] = edges.stepY[i] * s_CoarseBlockSize;
+			spanStepX[i] = edges.stepX[i] * blockWidth;
+		}
 
-				if (s_Settings.visualizeBoundingBox)
+		//blocks are aligned to the screen, evaluate the edge functions once in the first one
+		const int firstBlockX{ minX - (minX % s_CoarseBlockSize) };
+		const int firstBlockY{ minY - (minY % s_CoarseBlockSize) };
+		float blockRowEdgeValues[3]{};
+		EvaluateEdgeFunctions(GetScreenSpaceTriangle(binnedTriangle), { float(firstBlockX), float(firstBlockY) }, blockRowEdgeValues);
+
+		SIMD::CoverageBlock pixels{};
+
+		for (int blockY{ firstBlockY }; blockY < maxY; blockY += s_CoarseBlockSize)
+		{
+			float blockEdgeValues[3]{ blockRowEdgeValues[0], blockRowEdgeValues[1], blockRowEdgeValues[2] };
+			blockRowEdgeValues[0] += blockStepY[0];
+			blockRowEdgeValues[1] += blockStepY[1];
+			blockRowEdgeValues[2] += blockStepY[2];
+
+			for (int blockX{ firstBlockX }; blockX < maxX; blockX += s_CoarseBlockSize)
+			{
+				const float cornerEdgeValues[3]{ blockEdgeValues[0], blockEdgeValues[1], blockEdgeValues[2] };
+				blockEdgeValues[0] += blockStepX[0];
+				blockEdgeValues[1] += blockStepX[1];
+				blockEdgeValues[2] += blockStepX[2];
+
+				//trivial reject when one edge is negative over the whole block,
+				//trivial accept when all edges are positive over the whole block
+				bool isOutside{ false };
+				bool isFullyCovered{ true };
+				for (size_t i{}; i < 3; ++i)
 				{
-					m_pBackBufferPixels[s_RenderStats.currentPixel] = RGB(255, 255, 255);
-					continue;
+					const float cornerValue{ orientation * cornerEdgeValues[i] };
+					if (cornerValue + maxBlockOffset[i] < 0.f)
+						isOutside = true;
+					if (cornerValue + minBlockOffset[i] < 0.f)
+						isFullyCovered = false;
 				}
 
-				float crossArr[3]{};
+				if (isOutside)
+					continue;
 
-				if (IsPixelInTriangle(triangleScreenSpace, { float(px), float(py) }, crossArr))
-				{
-					std::array<float, 3> weights{};
-					CalculateBarycentricWeights(weights[0], weights[1], weights[2], crossArr);
+				//hierarchical z
+				const size_t blockIdx{ size_t(blockX / s_CoarseBlockSize + (blockY / s_CoarseBlockSize) * m_NumCoarseBlocksX) };
+				const float minDepth{ minDepthOffset + edges.invArea * (cornerEdgeValues[0] * coverage.depth[0]
+					+ cornerEdgeValues[1] * coverage.depth[1]
+					+ cornerEdgeValues[2] * coverage.depth[2]) };
+				const float blockMinDepth{ Max(binnedTriangle.minDepth, minDepth * s_CoarseDepthMargin) };
+
+				if (blockMinDepth >= GetCoarseDepth(blockIdx))
+					continue;
 
-					float pixelZ{ 1.f / GetBarycentricInterpolation(
-						1.f / triangle[0].position.z,
-						1.f / triangle[1].position.z,
-						1.f / triangle[2].position.z, weights) };
+				uint32_t blockMask{};
 
-					if (pixelZ > 1.f || pixelZ < 0.f)
-						break;
+				//part of the block inside the pixelrange
+				const int startX{ Max(blockX, minX) };
+				const int startY{ Max(blockY, minY) };
+				const int endX{ Min(blockX + s_CoarseBlockSize, maxX) };
+				const int endY{ Min(blockY + s_CoarseBlockSize, maxY) };
+
+				float rowEdgeValues[3]{};
+				for (size_t i{}; i < 3; ++i)
+				{
+					rowEdgeValues[i] = cornerEdgeValues[i]
+						+ edges.stepX[i] * float(startX - blockX)
+						+ edges.stepY[i] * float(startY - blockY);
+				}
 
-					if (pixelZ < m_pDepthBuffer[s_RenderStats.currentPixel]) //depthtest
+				for (int py{ startY }; py < endY; ++py)
+				{
+					float spanEdgeValues[3]{ rowEdgeValues[0], rowEdgeValues[1], rowEdgeValues[2] };
+					rowEdgeValues[0] += edges.stepY[0];
+					rowEdgeValues[1] += edges.stepY[1];
+					rowEdgeValues[2] += edges.stepY[2];
+
+					for (int px{ startX }; px < endX; px += blockWidth)
 					{
-						if (s_pMaterialBuffer->depthWrite)
-							m_pDepthBuffer[s_RenderStats.currentPixel] = pixelZ;
+						const float edgeValues[3]{ spanEdgeValues[0], spanEdgeValues[1], spanEdgeValues[2] };
+						spanEdgeValues[0] += spanStepX[0];
+						spanEdgeValues[1] += spanStepX[1];
+						spanEdgeValues[2] += spanStepX[2];
 
-						if (s_Settings.visualizeDepthBuffer)
-						{
-							ColorRGB depthColor{ pixelZ, pixelZ, pixelZ };
-							depthColor.MaxToOne();
-							float depthRemapped = Remap(depthColor.r, 0.997f, 1.f);
-							m_pBackBufferPixels[s_RenderStats.currentPixel] = SDL_MapRGB(m_pBackBuffer->format,
-								static_cast<uint8_t>(depthRemapped * 255),
-								static_cast<uint8_t>(depthRemapped * 255),
-								static_cast<uint8_t>(depthRemapped * 255));
+						const int numPixels{ Min(blockWidth, endX - px) };
+						const size_t firstPixel{ GetPixelIndex(px, py) };
+
+						//coverage + depthtest for the whole span at once
+						const uint32_t mask{ (isFullyCovered)
+							? SIMD::InterpolateBlock(coverage, edgeValues, m_pDepthBuffer + firstPixel, numPixels, pixels)
+							: SIMD::RasterizeBlock(coverage, edgeValues, m_pDepthBuffer + firstPixel, numPixels, pixels) };
+
+						//rejected spans cost nothing past the depthtest
+						if (mask == 0)
 							continue;
-						}
 
-						const float interpelatedW{ 1.f / GetBarycentricInterpolation(
-						invPosW0,
-						invPosW1,
-						invPosW2, weights) };
+						switch (pass)
+						{
+						case RasterPass::Visibility:
+							WriteVisibility(triangleIdx, pixels, mask, firstPixel);
+							break;
 
-						Vertex_Out currentPixelData{};
+						case RasterPass::Depth:
+							WriteDepth(pixels, mask, firstPixel);
+							break;
 
-						currentPixelData.uv = interpelatedW * GetBarycentricInterpolation(
-							triangle[0].uv * invPosW0,
-							triangle[1].uv * invPosW1,
-							triangle[2].uv * invPosW2, weights);
+						default:
+							(this->*pShadePixels)(binnedTriangle, pixels, mask, px, py);
+							break;
+						}
+						blockMask |= mask;
+					}
+				}
 
-						currentPixelData.position = GetBarycentricInterpolation(
-							triangle[0].position * invPosW0,
-							triangle[1].position * invPosW1,
-							triangle[2].position * invPosW2, weights) * interpelatedW;
+				if (isDepthWrite && blockMask != 0)
+				{
+					m_CoarseDepthDirty[blockIdx] = 1;
+					tile.isDepthDirty = true;
+				}
+			}
+		}
+	}
 
-						currentPixelData.normal = interpelatedW * GetBarycentricInterpolation(
-							triangle[0].normal * invPosW0,
-							triangle[1].normal * invPosW1,
-							triangle[2].normal * invPosW2, weights);
+	template <SoftwareRasterizer::PixelShader Shader, bool UseNormalMap, bool WriteDepth>
+	void SoftwareRasterizer::ShadePixels(const BinnedTriangle& triangle, const SIMD::CoverageBlock& pixels, uint32_t mask, int px, int py) const
+	{
+		const size_t firstPixel{ GetPixelIndex(px, py) };
 
-						currentPixelData.tangent = interpelatedW * GetBarycentricInterpolation(
-							triangle[0].tangent * invPosW0,
-							triangle[1].tangent * invPosW1,
-							triangle[2].tangent * invPosW2, weights);
+		if constexpr (WriteDepth)
+		{
+			for (uint32_t lanes{ mask }; lanes != 0; lanes &= lanes - 1)
+			{
+				const int pixelIdx{ std::countr_zero(lanes) };
+				m_pDepthBuffer[firstPixel + pixelIdx] = pixels.depth[pixelIdx];
+			}
+		}
 
-						currentPixelData.viewDirection = interpelatedW * GetBarycentricInterpolation(
-							triangle[0].viewDirection * invPosW0,
-							triangle[1].viewDirection * invPosW1,
-							triangle[2].viewDirection * invPosW2, weights);
+		if constexpr (Shader == PixelShader::Depth)
+		{
+			for (uint32_t lanes{ mask }; lanes != 0; lanes &= lanes - 1)
+			{
+				const int pixelIdx{ std::countr_zero(lanes) };
+				ShadeDepth(pixels.depth[pixelIdx], firstPixel + pixelIdx);
+			}
+		}
+		else
+		{
+			//the whole span goes through the shader at once, only the lanes in mask are written back
+			//lanes without texture samples stay zero
+			SIMD::ShadingBlock block{};
+			SIMD::InterpolateAttributes(triangle.attributes, GetPixelShaderVaryings(Shader, UseNormalMap), float(px), float(py), block);
+
+			//one mip level for the whole span, taken in the middle of the pixels it shades
+			UVDerivatives derivatives{};
+			if constexpr ((GetPixelShaderVaryings(Shader, UseNormalMap) & SIMD::VaryingUV) != 0)
+			{
+				const int middlePixel{ (std::countr_zero(mask) + std::bit_width(mask) - 1) / 2 };
+				derivatives = GetUVDerivatives(triangle.attributes, float(px + middlePixel), float(py));
+			}
+			SampleTextures<Shader, UseNormalMap>(block, derivatives);
 
-						currentPixelData.normal.Normalize();
-						currentPixelData.tangent.Normalize();
-						currentPixelData.viewDirection.Normalize();
+			if constexpr (Shader == PixelShader::Flat)
+			{
+				//alpha blends the diffuse samples over the backbuffer
+				SIMD::BlendPixels(m_BackBufferFormat, block.diffuse, mask, m_pColorBuffer + firstPixel);
+			}
+			else
+			{
+				if constexpr (UseNormalMap)
+					SIMD::ApplyNormalMap(block);
 
-						m_pBackBufferPixels[s_RenderStats.currentPixel] = PixelShading(currentPixelData);
-					}
-				}
+				const SIMD::LightSetup light
+				{
+					{ m_pLightBuffer->direction.x, m_pLightBuffer->direction.y, m_pLightBuffer->direction.z },
+					m_pLightBuffer->intensity
+				};
+
+				if constexpr (Shader == PixelShader::Lambert)
+					SIMD::ShadeLambertPhong(light, block);
+				else if constexpr (Shader == PixelShader::ObservedArea)
+					SIMD::ShadeObservedArea(light, block);
+				else if constexpr (Shader == PixelShader::Diffuse)
+					SIMD::ShadeDiffuse(light, block);
+				else
+					SIMD::ShadeSpecular(light, block);
+
+				SIMD::StorePixels(m_BackBufferFormat, block.color, mask, m_pColorBuffer + firstPixel);
 			}
 		}
+	}
+
+	template <SoftwareRasterizer::PixelShader Shader, bool UseNormalMap>
+	void SoftwareRasterizer::SampleTextures(SIMD::ShadingBlock& block, const UVDerivatives& derivatives) const
+	{
+		//texture slots: diffuse, normal, specular, glossiness
+		const auto& textures{ s_pMaterialBuffer->textures };
+		constexpr bool readsDiffuse{ Shader == PixelShader::Lambert || Shader == PixelShader::Diffuse };
+		constexpr bool readsSpecular{ Shader == PixelShader::Lambert || Shader == PixelShader::Specular };
+		constexpr bool readsNormalMap{ UseNormalMap && (GetPixelShaderVaryings(Shader, false) & SIMD::VaryingNormal) != 0 };
+
+		const float* pU{ block.uv[0] };
+		const float* pV{ block.uv[1] };
+		const SamplerState sampler{ GetSamplerState() };
+
+		if constexpr (Shader == PixelShader::Flat)
+			ResourceManager::GetTexture(textures[0]).SampleBlock(pU, pV, derivatives, sampler, 4, block.diffuse);
+
+		if constexpr (readsDiffuse)
+			ResourceManager::GetTexture(textures[0]).SampleBlock(pU, pV, derivatives, sampler, 3, block.diffuse);
+
+		if constexpr (readsNormalMap)
+			ResourceManager::GetTexture(textures[1]).SampleBlock(pU, pV, derivatives, sampler, 3, block.normalSample);
+
+		if constexpr (readsSpecular)
+		{
+			ResourceManager::GetTexture(textures[2]).SampleBlock(pU, pV, derivatives, sampler, 1, &block.specular);
+			ResourceManager::GetTexture(textures[3]).SampleBlock(pU, pV, derivatives, sampler, 1, &block.glossiness);
+		}
+	}
 
+	SamplerState SoftwareRasterizer::GetSamplerState() const
+	{
+		//FilterMode is in the same order as SamplerState::Filter, TextureAddressMode as SIMD::TextureAddress
+		SamplerState sampler{};
+		sampler.filter = static_cast<SamplerState::Filter>(s_Settings.filterMode);
+		sampler.address = static_cast<SIMD::TextureAddress>(s_Settings.textureAddressMode);
+		return sampler;
+	}
+
+	UVDerivatives SoftwareRasterizer::GetUVDerivatives(const SIMD::AttributePlanes& planes, float x, float y) const
+	{
+		//u = (u / w) / (1 / w), both are planes, the quotient rule gives du/dx = (d(u / w)/dx - u * d(1 / w)/dx) * w
+		const float dx{ x - planes.origin[0] };
+		const float dy{ y - planes.origin[1] };
+		const float w{ 1.f / (planes.value[SIMD::InvWAttribute] + planes.ddx[SIMD::InvWAttribute] * dx + planes.ddy[SIMD::InvWAttribute] * dy) };
+		const float u{ (planes.value[0] + planes.ddx[0] * dx + planes.ddy[0] * dy) * w };
+		const float v{ (planes.value[1] + planes.ddx[1] * dx + planes.ddy[1] * dy) * w };
+
+		UVDerivatives derivatives{};
+		derivatives.dUdX = (planes.ddx[0] - u * planes.ddx[SIMD::InvWAttribute]) * w;
+		derivatives.dVdX = (planes.ddx[1] - v * planes.ddx[SIMD::InvWAttribute]) * w;
+		derivatives.dUdY = (planes.ddy[0] - u * planes.ddy[SIMD::InvWAttribute]) * w;
+		derivatives.dVdY = (planes.ddy[1] - v * planes.ddy[SIMD::InvWAttribute]) * w;
+		return derivatives;
 	}
 
-	
+	void SoftwareRasterizer::WriteDepth(const SIMD::CoverageBlock& pixels, uint32_t mask, size_t firstPixel) const
+	{
+		while (mask != 0)
+		{
+			const int pixelIdx{ std::countr_zero(mask) };
+			mask &= mask - 1;
+
+			m_pDepthBuffer[firstPixel + pixelIdx] = pixels.depth[pixelIdx];
+		}
+	}
+
+	void SoftwareRasterizer::WriteVisibility(uint32_t triangleIdx, const SIMD::CoverageBlock& pixels, uint32_t mask, size_t firstPixel) const
+	{
+		while (mask != 0)
+		{
+			const int pixelIdx{ std::countr_zero(mask) };
+			mask &= mask - 1;
+
+			const size_t pixel{ firstPixel + pixelIdx };
+			m_pDepthBuffer[pixel] = pixels.depth[pixelIdx];
+			m_pVisibilityBuffer[pixel] = { triangleIdx };
+		}
+	}
 
-	ColorRGB SoftwareRasterizer::Lambert(float kd, const ColorRGB& cd) const
+	void SoftwareRasterizer::ShadeDepth(float depth, size_t pixel) const
 	{
-		return kd * cd * PI_INV;
+		ColorRGB depthColor{ depth, depth, depth };
+		depthColor.MaxToOne();
+		float depthRemapped = Remap(depthColor.r, 0.997f, 1.f);
+		m_pColorBuffer[pixel] = SDL_MapRGB(m_pBackBuffer->format,
+			static_cast<uint8_t>(depthRemapped * 255),
+			static_cast<uint8_t>(depthRemapped * 255),
+			static_cast<uint8_t>(depthRemapped * 255));
 	}
 
-	ColorRGB SoftwareRasterizer::Phong(float ks, float exp, const Vector3& l, const Vector3& v, const Vector3& n) const
+	template <typename T>
+	void SoftwareRasterizer::FillPixels(T* pBuffer, int minX, int minY, int maxX, int maxY, const T& value) const
 	{
-		Vector3 reflect{ Vector3::Reflect(l, n) };
-		float cosAlpha{ Max(Vector3::Dot(v, reflect), 0.f) };
+		for (int py{ minY }; py < maxY; ++py)
+		{
+			//one contiguous run per block the row crosses
+			for (int px{ minX }; px < maxX; )
+			{
+				const int endX{ Min(px - (px % s_CoarseBlockSize) + s_CoarseBlockSize, maxX) };
+				std::fill_n(pBuffer + GetPixelIndex(px, py), endX - px, value);
+				px = endX;
+			}
+		}
+	}
 
-		float specular{ (cosAlpha > 0.f) ? ks * powf(cosAlpha, exp) : 0.f };
-		return ColorRGB{ specular, specular, specular };
+	void SoftwareRasterizer::ResolveTiledFramebuffer() const
+	{
+		//every block row is spread over the threads, blocks are copied one row of pixels at a time
+		const int pitch{ m_pBackBuffer->pitch / int(sizeof(uint32_t)) };
+		m_pThreadPool->ParallelFor(size_t(m_NumCoarseBlocksY), [this, pitch](size_t blockY)
+			{
+				const int minY{ int(blockY) * s_CoarseBlockSize };
+				const int maxY{ Min(minY + s_CoarseBlockSize, m_Height) };
+				const uint32_t* pBlock{ m_pTiledColorBuffer + blockY * m_NumCoarseBlocksX * (s_CoarseBlockSize * s_CoarseBlockSize) };
+				for (int blockX{}; blockX < m_NumCoarseBlocksX; ++blockX)
+				{
+					const int minX{ blockX * s_CoarseBlockSize };
+					const int numPixels{ Min(s_CoarseBlockSize, m_Width - minX) };
+					for (int py{ minY }; py < maxY; ++py)
+					{
+						std::copy_n(pBlock + (py - minY) * s_CoarseBlockSize, numPixels, m_pBackBufferPixels + minX + py * pitch);
+					}
+					pBlock += s_CoarseBlockSize * s_CoarseBlockSize;
+				}
+			});
 	}
-}
\ No newline at end of file
+}
@@ -1,5 +1,7 @@
 #pragma once
 #include "Renderer.h"
+#include "DataTypes.h"
+#include "RasterizerSIMD.h"
 
 #include <functional>
 
@@ -16,6 +18,9 @@ namespace dae
 	struct Material;
 	struct Triangle;
 	class TextureSoftware;
+	struct UVDerivatives;
+	struct SamplerState;
+	class ThreadPool;
 
 	typedef std::array<Vector2, 3> TriangleVec2;
 
@@ -38,64 +43,277 @@ namespace dae
 		virtual void RenderMesh(Mesh* pMesh, const Camera& camera) const override;
 
 	private:
-		// transforms the vertices from the mesh from World space to Screen space
-		void VertexTransformationFunction(Mesh& mesh, const Camera& camera) const;
-		Vector2 VertexToScreenSpace(const Vector4& vertex) const;
-		// vertices in NDC space
-		// crossArr parameter (sizeof 3!) is used to store the crossproducts which are needed for the weightcalculation
-		bool IsPixelInTriangle(const TriangleVec2& verts, const Vector2& pixel, float* crossArr) const;
-		//crossArr parameter (sizeof 3!)
-		template <typename T>
-		inline T GetBarycentricInterpolation(const T& v0, const T& v1, const T& v2, const std::array<float, 3>& weights) const
+		// screen is split in tiles of s_TileSize x s_TileSize pixels, each tile is rasterized by one thread
+		static constexpr int s_TileSize{ 64 };
+		// tiles are walked in blocks of s_CoarseBlockSize x s_CoarseBlockSize pixels that are
+		// rejected or accepted as a whole before any per pixel edge test
+		static constexpr int s_CoarseBlockSize{ 8 };
+		// nearest depth estimates are scaled by this before they are compared against the hierarchical z
+		static constexpr float s_CoarseDepthMargin{ 1.f - 1e-6f };
+		// vertices with |x| and |y| within s_GuardBand * w are not clipped geometrically,
+		// the bounding box scissors them to the screen instead
+		static constexpr float s_GuardBand{ 4.f };
+		// clipping a triangle against the near plane + 4 guard band planes adds at most 5 vertices
+		static constexpr size_t s_MaxClipVertices{ 8 };
+		// vertices transformed per job, multiple of SIMD::MaxBlockWidth
+		static constexpr size_t s_VertexChunkSize{ 1024 };
+
+		using ClipPolygon = std::array<Vertex_Out, s_MaxClipVertices>;
+
+		// half-space edge functions of a screenspace triangle, set up once per triangle
+		// edge i is the edge opposite of vertex i, its value is the (unnormalized) barycentric weight of vertex i
+		// stepping one pixel in x adds stepX[i], stepping one pixel in y adds stepY[i]
+		struct EdgeFunctions
 		{
-			return v0 * weights[0] + v1 * weights[1] + v2 * weights[2];
-		}
+			std::array<float, 3> stepX{};
+			std::array<float, 3> stepY{};
+			float invArea{};
+		};
+
+		// inputs of every pixel shader, see GetPixelShaderVaryings
+		static constexpr uint32_t s_LambertVaryings{ SIMD::VaryingUV | SIMD::VaryingNormal | SIMD::VaryingViewDirection };
+		static constexpr uint32_t s_FlatVaryings{ SIMD::VaryingUV };
+		static constexpr uint32_t s_ObservedAreaVaryings{ SIMD::VaryingNormal };
+		static constexpr uint32_t s_DiffuseVaryings{ SIMD::VaryingUV | SIMD::VaryingNormal };
+		static constexpr uint32_t s_SpecularVaryings{ SIMD::VaryingUV | SIMD::VaryingNormal | SIMD::VaryingViewDirection };
+		// added to shaders that read the normal when normal mapping is on
+		static constexpr uint32_t s_NormalMapVaryings{ SIMD::VaryingUV | SIMD::VaryingNormal | SIMD::VaryingTangent };
 
-		void CalculateBarycentricWeights(float& w0, float& w1, float& w2, float* crossArr) const
+		// the pixel shader that ends up running, Material::shaderId + ShadingMode resolve to one of these
+		enum class PixelShader
 		{
-			float invTotalAreaParallogram{ 1.f / (crossArr[0] + crossArr[1] + crossArr[2]) };
-			 w0 = crossArr[0] * invTotalAreaParallogram;
-			 w1 = crossArr[1] * invTotalAreaParallogram;
-			 w2 = crossArr[2] * invTotalAreaParallogram;
+			Lambert,
+			ObservedArea,
+			Diffuse,
+			Specular,
+			Flat,
+			Depth,		// visualizeDepthBuffer, shows the depth instead of running a shader
+			End
+		};
+
+		static constexpr uint32_t GetPixelShaderVaryings(PixelShader shader, bool useNormalMap)
+		{
+			uint32_t varyings{};
+			switch (shader)
+			{
+			case PixelShader::Lambert:		varyings = s_LambertVaryings; break;
+			case PixelShader::ObservedArea:	varyings = s_ObservedAreaVaryings; break;
+			case PixelShader::Diffuse:		varyings = s_DiffuseVaryings; break;
+			case PixelShader::Specular:		varyings = s_SpecularVaryings; break;
+			case PixelShader::Flat:			varyings = s_FlatVaryings; break;
+			}
+
+			if (useNormalMap && (varyings & SIMD::VaryingNormal))
+				varyings |= s_NormalMapVaryings;
+
+			return varyings;
 		}
-		bool IsPointInFrustum(const Vector4& point) const;
 
-		void PerspectiveDivide(Triangle& triangle) const;
+		struct BinnedTriangle;
+		using ShadePixelsFunction = void (SoftwareRasterizer::*)(const BinnedTriangle&, const SIMD::CoverageBlock&, uint32_t, int, int) const;
+
+		// one permutation of the pixel stage, everything the settings decide is baked in at compile time
+		// picked once per draw by GetPixelPipeline, see s_PixelPipelines
+		struct PixelPipeline
+		{
+			uint32_t varyings{};
+			// indexed by whether the pass writes depth
+			ShadePixelsFunction pShadePixels[2]{};
+		};
+
+		// post-transform triangle, ready to be rasterized by the tiles it overlaps
+		// vertices are read from pMesh->vertices_out/vertices_screen
+		struct BinnedTriangle
+		{
+			Mesh* pMesh{ nullptr };
+			std::array<uint32_t, 3> indices{};
+			EdgeFunctions edges{};
+			SIMD::AttributePlanes attributes{};
+			// attribute planes are only set up for pPipeline->varyings
+			const PixelPipeline* pPipeline{ nullptr };
+			int minX{}, minY{}, maxX{}, maxY{};
+			// depth of the nearest vertex, no pixel of the triangle is closer
+			float minDepth{};
+			Material* pMaterial{ nullptr };
+		};
+
+		// where the triangles of the last frame ended up, reset every frame
+		struct TriangleStats
+		{
+			size_t numSubmitted{};
+			size_t numFrustumCulled{};
+			size_t numClipped{};
+			size_t numFaceCulled{};
+			size_t numDegenerate{};
+			size_t numSubPixel{};
+		};
+
+		// what RenderTriangle does with the pixels that pass the depthtest
+		enum class RasterPass
+		{
+			Forward,		// shade them right away
+			Visibility,		// depth writing triangles only, store triangle + barycentrics to shade later
+			Depth,			// depth writing triangles only, write depth and nothing else
+			Opaque,			// depth writing triangles only, shade the pixels that match the depth of the Depth pass
+			Transparent		// triangles that don't write depth only, shaded right away
+		};
+
+		static constexpr uint32_t s_InvalidTriangle{ UINT32_MAX };
+		// one pixel of the visibility buffer
+		// the attributes are recovered from the planes of the triangle at the pixel
+		struct VisibilitySample
+		{
+			uint32_t triangleIdx{ s_InvalidTriangle };
+		};
+
+		struct VertexJob
+		{
+			Mesh* pMesh{ nullptr };
+			size_t transformIdx{};
+			size_t first{};
+			size_t count{};
+		};
+
+		struct Tile
+		{
+			int minX{}, minY{}, maxX{}, maxY{};
+			// indices into m_BinnedTriangles, in submission order
+			std::vector<uint32_t> triangles{};
+
+			// farthest depth stored in the tile, only valid when isDepthDirty is false
+			float maxDepth{ FLT_MAX };
+			bool isDepthDirty{ false };
+			// triangles rejected by the hierarchical z test
+			size_t numDepthCulled{};
+		};
+
+		// transforms the vertices of all meshes from World space to Screen space
+		// every mesh is split in chunks of s_VertexChunkSize vertices that are spread over the threadpool
+		void VertexTransformationFunction(const std::vector<RenderQueue::DrawItem>& drawItems, const Camera& camera) const;
+		// SoA copy of mesh.vertices for the SIMD vertex kernel
+		void CreateVertexStreams(Mesh& mesh) const;
+		SIMD::VertexTransform CreateVertexTransform(const Mesh& mesh, const Camera& camera) const;
+		// screenspace data for vertices created by clipping, vertex in clipspace
+		Vertex_Screen VertexToScreenSpace(const Vector4& vertex) const;
+		TriangleVec2 GetScreenSpaceTriangle(const BinnedTriangle& triangle) const;
+		// returns false for degenerate (zero area) triangles
+		bool SetupEdgeFunctions(const TriangleVec2& verts, EdgeFunctions& edges) const;
+		// gradients of the attributes / w, derived from the edge functions
+		void SetupAttributePlanes(const BinnedTriangle& triangle, SIMD::AttributePlanes& planes) const;
+		// evaluates all edge functions for a single pixel, only needed once per triangle/tile
+		// edgeValues parameter (sizeof 3!)
+		void EvaluateEdgeFunctions(const TriangleVec2& verts, const Vector2& pixel, float* edgeValues) const;
+
+		// point in clip space (before the perspective divide)
+		float GetClipDistance(const Vector4& point, SIMD::ClipCode plane) const;
+		// clips a clip space triangle against the near plane and the guard band, returns the number of vertices in polygon
+		size_t ClipTriangle(const Triangle& triangle, ClipPolygon& polygon) const;
+
 		// used to minimize pixels overlap test
-		// triangle in screenspace
+		// triangle in screenspace, max is exclusive
 		void GetBoundingBoxPixelsFromTriangle(const TriangleVec2& triangle, int& minX, int& minY, int& maxX, int& maxY) const;
 		void GetTriangleIndices(const Mesh& mesh, size_t triangleIndex, size_t& i0, size_t& i1, size_t& i2) const;
 		size_t GetIndexStep(PrimitiveTopology primitiveTopology) const;
 		void ProcessTriangle(size_t triangleIndex, Mesh* pMesh) const;
+		// indices into pMesh->vertices_out/vertices_screen
+		void SetupTriangle(Mesh* pMesh, const std::array<uint32_t, 3>& indices) const;
 		Vertex_Out LerpVertex(const Vertex_Out& triangle0, const Vertex_Out& triangle1, float t) const;
+		// checks the screenspace winding order against the current FaceCullingMode
+		bool IsFaceCulled(const EdgeFunctions& edges) const;
+
+		void CreateTiles();
+		// hierarchical z, recalculates the farthest depth of dirty blocks/tiles before returning it
+		void ClearCoarseDepth() const;
+		float GetCoarseDepth(size_t blockIdx) const;
+		float GetTileMaxDepth(Tile& tile) const;
+		// triangle setup is done in ProcessTriangle, only triangles that will produce pixels get binned
+		void BinTriangle(BinnedTriangle&& binnedTriangle) const;
+		void RenderTile(Tile& tile) const;
+		void RenderTriangles(Tile& tile, RasterPass pass) const;
+		void RenderTriangle(uint32_t triangleIdx, Tile& tile, RasterPass pass) const;
+		// shades the pixels of a block that passed the depthtest (bit i of mask = pixel (px + i, py), never 0) as one packet
+		template <PixelShader Shader, bool UseNormalMap, bool WriteDepth>
+		void ShadePixels(const BinnedTriangle& triangle, const SIMD::CoverageBlock& pixels, uint32_t mask, int px, int py) const;
+		// fetches the textures Shader reads for every lane, derivatives pick the mip level
+		template <PixelShader Shader, bool UseNormalMap>
+		void SampleTextures(SIMD::ShadingBlock& block, const UVDerivatives& derivatives) const;
+		// screenspace derivatives of the uv at pixel (x, y), exact for the perspective correct interpolation of planes
+		// sampler state of the filter and address mode in s_Settings
+		SamplerState GetSamplerState() const;
+		UVDerivatives GetUVDerivatives(const SIMD::AttributePlanes& planes, float x, float y) const;
+		// only writes the depth of the pixels, same mask as ShadePixels
+		void WriteDepth(const SIMD::CoverageBlock& pixels, uint32_t mask, size_t firstPixel) const;
+		// stores the pixels of a block that passed the depthtest in the visibility buffer, same mask as ShadePixels
+		void WriteVisibility(uint32_t triangleIdx, const SIMD::CoverageBlock& pixels, uint32_t mask, size_t firstPixel) const;
+		// shades every pixel in the visibility buffer of the tile once
+		void ResolveVisibility(const Tile& tile) const;
+		void ShadeDepth(float depth, size_t pixel) const;
+
+		// index of pixel (px, py) in the color, depth and visibility buffers
+		// tiled buffers store every s_CoarseBlockSize x s_CoarseBlockSize block as one row major run of pixels,
+		// so a span that stays inside a block (see RenderTriangle) is contiguous in both layouts
+		size_t GetPixelIndex(int px, int py) const
+		{
+			if (!m_IsFramebufferTiled)
+				return size_t(px + py * m_Width);
+
+			const size_t x{ static_cast<size_t>(px) }, y{ static_cast<size_t>(py) };
+			const size_t blockIdx{ (y / s_CoarseBlockSize) * m_NumCoarseBlocksX + x / s_CoarseBlockSize };
+			return blockIdx * (s_CoarseBlockSize * s_CoarseBlockSize) + (y % s_CoarseBlockSize) * s_CoarseBlockSize + x % s_CoarseBlockSize;
+		}
+		// fills the pixels [minX, maxX) x [minY, maxY) of a buffer indexed by GetPixelIndex
+		template <typename T>
+		void FillPixels(T* pBuffer, int minX, int minY, int maxX, int maxY, const T& value) const;
+		// copies the tiled color buffer to the backbuffer surface
+		void ResolveTiledFramebuffer() const;
+
+		// pixel pipeline of material with the current settings
+		const PixelPipeline& GetPixelPipeline(const Material& material) const;
+		template <PixelShader Shader, bool UseNormalMap>
+		static constexpr PixelPipeline CreatePixelPipeline();
 
-		void RenderTriangle(Triangle& triangle) const;
-		Uint32 PixelShading(const Vertex_Out& vertex) const;
-
-		ColorRGB LambertPixelShader(const Vertex_Out& vertex) const;
-		ColorRGB FlatPixelShader(const Vertex_Out& vertex) const;
-		ColorRGB ObservedAreaPixelShader(const Vertex_Out& vertex) const;
-		ColorRGB DiffusePixelShader(const Vertex_Out& vertex) const;
-		ColorRGB SpecularPixelShader(const Vertex_Out& vertex) const;
-		ColorRGB VehiclePixelShader(const Vertex_Out& vertex) const;
-
-		//shading
-		/**
-		 * \param kd Diffuse Reflection Coefficient
-		 * \param cd Diffuse Color
-		 * \return Lambert Diffuse Color
-		 */
-		ColorRGB Lambert(float kd, const ColorRGB& cd) const;
-		ColorRGB Phong(float ks, float exp, const Vector3& l, const Vector3& v, const Vector3& n) const;
-		Vector3 SampleNormalMap(const Vector3& normal, const Vector3& tangent, const Vector2& uv, const TextureSoftware& normalMap) const;
 
 		void ToggleShadingMode();
+		void CycleShadingPath();
+		void CycleKernelTier();
+		void CycleTextureAddressMode();
+		// applies s_Settings.kernelTier, returns the instruction set the kernels run with
+		SIMD::InstructionSet ApplyKernelTier() const;
+		void PrintTriangleStats() const;
 
 		SDL_Surface* m_pFrontBuffer{ nullptr };
 		SDL_Surface* m_pBackBuffer{ nullptr };
 		uint32_t* m_pBackBufferPixels{};
+		SIMD::PixelFormat m_BackBufferFormat{};
+		// color buffer in the tiled layout, padded to whole coarse blocks
+		uint32_t* m_pTiledColorBuffer{ nullptr };
+		// where the pixel stage writes this frame, m_pBackBufferPixels or m_pTiledColorBuffer
+		mutable uint32_t* m_pColorBuffer{ nullptr };
+		// layout of the color, depth and visibility buffers this frame, latched from s_Settings in Render
+		mutable bool m_IsFramebufferTiled{ false };
 		float* m_pDepthBuffer{ nullptr };
+		// triangle of the nearest opaque pixel, only used with ShadingPath::VisibilityBuffer
+		VisibilitySample* m_pVisibilityBuffer{ nullptr };
+
+		std::unique_ptr<ThreadPool> m_pThreadPool;
+		mutable std::vector<Tile> m_Tiles;
+		mutable std::vector<BinnedTriangle> m_BinnedTriangles;
+		mutable TriangleStats m_TriangleStats{};
+		mutable std::vector<SIMD::VertexTransform> m_VertexTransforms;
+		mutable std::vector<VertexJob> m_VertexJobs;
+
+		// farthest depth of every s_CoarseBlockSize x s_CoarseBlockSize block of m_pDepthBuffer
+		// a block is marked dirty when one of its pixels writes depth and recalculated the next time it is tested
+		// blocks never cross tiles, so each one is only touched by the thread rendering its tile
+		int m_NumCoarseBlocksX{};
+		int m_NumCoarseBlocksY{};
+		mutable std::vector<float> m_CoarseDepth;
+		mutable std::vector<uint8_t> m_CoarseDepthDirty;
+
+		static thread_local Material* s_pMaterialBuffer;
+		static thread_local const PixelPipeline* s_pPixelPipelineBuffer;
 
-		static Material* s_pMaterialBuffer;
+		// [PixelShader][useNormalMap]
+		static const std::array<std::array<PixelPipeline, 2>, size_t(PixelShader::End)> s_PixelPipelines;
 	};
 }
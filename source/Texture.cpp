@@ -1,89 +1,253 @@
 #include "pch.h"
 #include "Texture.h"
 
+#include <algorithm>
+#include <cfloat>
+#include <cmath>
+
 namespace dae
 {
+	//=======================//
+	// mip chain
+	//=======================//
+
+	MipChain::MipChain(const SDL_Surface* pSurface)
+	{
+		//decoded once here, no sampler ever looks at the surface format (SDL fills a missing alpha channel with 255)
+		SDL_Surface* pConverted{ nullptr };
+		if (pSurface->format->format != TexelFormat)
+		{
+			//SDL_ConvertSurfaceFormat only reads the source surface
+			pConverted = SDL_ConvertSurfaceFormat(const_cast<SDL_Surface*>(pSurface), TexelFormat, 0);
+			SDL_assert(pConverted && "Conversion to MipChain::TexelFormat failed!");
+			pSurface = pConverted;
+		}
+
+		//every level is half the size of the previous one (rounded down) until 1x1
+		int width{ pSurface->w };
+		int height{ pSurface->h };
+		size_t numTexels{};
+		while (true)
+		{
+			m_Levels.push_back({ numTexels, width, height });
+			numTexels += size_t(width) * size_t(height);
+			if (width == 1 && height == 1)
+				break;
+
+			width = Max(width / 2, 1);
+			height = Max(height / 2, 1);
+		}
+		m_Texels.resize(numTexels);
+
+		//the surface pitch can be wider than a row
+		for (int y{}; y < pSurface->h; ++y)
+		{
+			const uint32_t* pRow{ reinterpret_cast<const uint32_t*>(static_cast<const uint8_t*>(pSurface->pixels) + y * pSurface->pitch) };
+			std::copy_n(pRow, pSurface->w, m_Texels.data() + size_t(y) * size_t(pSurface->w));
+		}
+
+		if (pConverted)
+			SDL_FreeSurface(pConverted);
+
+		//box filter, every texel is the rounded average of the 2x2 texels it covers in the previous level
+		for (size_t level{ 1 }; level < m_Levels.size(); ++level)
+		{
+			const Level& source{ m_Levels[level - 1] };
+			const Level& destination{ m_Levels[level] };
+			const uint32_t* pSource{ m_Texels.data() + source.offset };
+			uint32_t* pDestination{ m_Texels.data() + destination.offset };
+
+			for (int y{}; y < destination.height; ++y)
+			{
+				//a side that is already 1 texel wide repeats its only row/column
+				const size_t row0{ size_t(Min(y * 2, source.height - 1)) * size_t(source.width) };
+				const size_t row1{ size_t(Min(y * 2 + 1, source.height - 1)) * size_t(source.width) };
+				for (int x{}; x < destination.width; ++x)
+				{
+					const size_t column0{ size_t(Min(x * 2, source.width - 1)) };
+					const size_t column1{ size_t(Min(x * 2 + 1, source.width - 1)) };
+					const uint32_t texels[4]{ pSource[row0 + column0], pSource[row0 + column1], pSource[row1 + column0], pSource[row1 + column1] };
+
+					uint32_t texel{};
+					for (uint32_t shift{}; shift < 32; shift += 8)
+					{
+						uint32_t sum{ 2 };
+						for (uint32_t sample : texels)
+							sum += (sample >> shift) & 0xFF;
+						texel |= (sum / 4) << shift;
+					}
+					pDestination[size_t(x) + size_t(y) * size_t(destination.width)] = texel;
+				}
+			}
+		}
+	}
+
 	//=======================//
 	// software
 	//=======================//
 
-	TextureSoftware::TextureSoftware(SDL_Surface* pSurface)
-		: m_pSurface{ pSurface }
-		, m_pSurfacePixels{ (uint32_t*)pSurface->pixels }
+	TextureSoftware::TextureSoftware(const MipChain& mipChain)
+		: m_MipLevels{ CreateMipLevels(mipChain, TexelLayout::Blocked, m_Texels) }
 	{
+	}
+
+	size_t TextureSoftware::GetTexelIndex(const SIMD::TextureTexels& texture, int x, int y)
+	{
+		if (texture.blocksPerRow == 0)
+			return size_t(x) + size_t(y) * size_t(texture.width);
 
+		constexpr int blockMask{ SIMD::TexelBlockSize - 1 };
+		const size_t blockIdx{ size_t(y >> SIMD::TexelBlockShift) * size_t(texture.blocksPerRow) + size_t(x >> SIMD::TexelBlockShift) };
+		return (blockIdx << (2 * SIMD::TexelBlockShift)) + (size_t(y & blockMask) << SIMD::TexelBlockShift) + size_t(x & blockMask);
 	}
 
-	TextureSoftware::~TextureSoftware()
+	void TextureSoftware::SampleBlock(const float* pU, const float* pV, const UVDerivatives& derivatives, const SamplerState& sampler, int numChannels, float (*pChannels)[SIMD::MaxBlockWidth]) const
 	{
-		if (m_pSurface)
+		if (sampler.filter == SamplerState::Filter::Point)
+		{
+			//MIN_MAG_MIP_POINT, nearest level
+			float lengthSquaredX{}, lengthSquaredY{};
+			GetFootprint(derivatives, lengthSquaredX, lengthSquaredY);
+			const int level{ static_cast<int>(GetLevelOfDetail(Max(lengthSquaredX, lengthSquaredY)) + 0.5f) };
+			SIMD::SampleTexels(m_MipLevels[size_t(level)], sampler.address, pU, pV, numChannels, pChannels);
+			return;
+		}
+
+		//the filtered samples are accumulated
+		for (int c{}; c < numChannels; ++c)
+			std::fill_n(pChannels[c], SIMD::MaxBlockWidth, 0.f);
+
+		if (sampler.filter == SamplerState::Filter::Anisotropic)
 		{
-			SDL_FreeSurface(m_pSurface);
-			m_pSurface = nullptr;
+			SampleAnisotropic(pU, pV, derivatives, sampler, numChannels, pChannels);
+		}
+		else
+		{
+			float lengthSquaredX{}, lengthSquaredY{};
+			GetFootprint(derivatives, lengthSquaredX, lengthSquaredY);
+			SampleTrilinear(pU, pV, GetLevelOfDetail(Max(lengthSquaredX, lengthSquaredY)), sampler.address, 1.f, numChannels, pChannels);
 		}
 	}
 
-	TextureSoftware* TextureSoftware::LoadFromFile(const std::string& path)
+	void TextureSoftware::SampleTrilinear(const float* pU, const float* pV, float levelOfDetail, SIMD::TextureAddress address, float weight, int numChannels, float (*pChannels)[SIMD::MaxBlockWidth]) const
 	{
-		return new TextureSoftware(IMG_Load(path.c_str()));
+		const int level{ static_cast<int>(levelOfDetail) };
+		const float blend{ levelOfDetail - static_cast<float>(level) };
+
+		//a blend that doesn't change the 8 bit result isn't worth the second level
+		if (blend < 1.f / 256.f || level + 1 == static_cast<int>(m_MipLevels.size()))
+		{
+			SIMD::SampleTexelsBilinear(m_MipLevels[size_t(level)], address, pU, pV, weight, numChannels, pChannels);
+			return;
+		}
+
+		SIMD::SampleTexelsBilinear(m_MipLevels[size_t(level)], address, pU, pV, weight * (1.f - blend), numChannels, pChannels);
+		SIMD::SampleTexelsBilinear(m_MipLevels[size_t(level) + 1], address, pU, pV, weight * blend, numChannels, pChannels);
 	}
 
-	ColorRGB TextureSoftware::Sample(const Vector2& uv) const
+	void TextureSoftware::SampleAnisotropic(const float* pU, const float* pV, const UVDerivatives& derivatives, const SamplerState& sampler, int numChannels, float (*pChannels)[SIMD::MaxBlockWidth]) const
 	{
-		Uint8 r{}, g{}, b{};
+		float lengthSquaredX{}, lengthSquaredY{};
+		GetFootprint(derivatives, lengthSquaredX, lengthSquaredY);
+		const bool isMajorX{ lengthSquaredX >= lengthSquaredY };
+		const float majorLength{ sqrtf(isMajorX ? lengthSquaredX : lengthSquaredY) };
+		const float minorLength{ sqrtf(isMajorX ? lengthSquaredY : lengthSquaredX) };
+
+		//one tap per minor axis length along the major axis, each tap covers a roughly square part of the footprint
+		int numTaps{ 1 };
+		if (majorLength > 1.f && minorLength < majorLength)
+		{
+			const float ratio{ (minorLength > 0.f) ? majorLength / minorLength : FLT_MAX };
+			numTaps = static_cast<int>(ceilf(Min(ratio, static_cast<float>(sampler.maxAnisotropy))));
+		}
 
-		Vector2 tilesUv{ uv };
+		const float tapLength{ majorLength / numTaps };
+		const float levelOfDetail{ GetLevelOfDetail(tapLength * tapLength) };
+		if (numTaps == 1)
+		{
+			SampleTrilinear(pU, pV, levelOfDetail, sampler.address, 1.f, numChannels, pChannels);
+			return;
+		}
+
+		//taps at the centers of numTaps equal parts of the major axis
+		const float axisU{ isMajorX ? derivatives.dUdX : derivatives.dUdY };
+		const float axisV{ isMajorX ? derivatives.dVdX : derivatives.dVdY };
+		const float weight{ 1.f / numTaps };
+		alignas(32) float tapU[SIMD::MaxBlockWidth];
+		alignas(32) float tapV[SIMD::MaxBlockWidth];
+		for (int tap{}; tap < numTaps; ++tap)
+		{
+			const float offset{ (tap + 0.5f) * weight - 0.5f };
+			for (int i{}; i < SIMD::MaxBlockWidth; ++i)
+			{
+				tapU[i] = pU[i] + offset * axisU;
+				tapV[i] = pV[i] + offset * axisV;
+			}
+			SampleTrilinear(tapU, tapV, levelOfDetail, sampler.address, weight, numChannels, pChannels);
+		}
+	}
 
-		//tiling
-		//clamp to edge
-		if (tilesUv.x < 0.f)
-			tilesUv.x = 0.f;
-		else if (tilesUv.x > 1.f)
-			tilesUv.x = 1.f;
-		if (tilesUv.y < 0.f)
-			tilesUv.y = 0.f;
-		else if (tilesUv.y > 1.f)
-			tilesUv.y = 1.f;
+	std::vector<SIMD::TextureTexels> TextureSoftware::CreateMipLevels(const MipChain& mipChain, TexelLayout layout, std::vector<uint32_t>& texels)
+	{
+		std::vector<SIMD::TextureTexels> levels(size_t(mipChain.GetNumLevels()));
+		std::vector<size_t> offsets(levels.size());
+		size_t numTexels{};
+		for (size_t level{}; level < levels.size(); ++level)
+		{
+			SIMD::TextureTexels& texture{ levels[level] };
+			texture.width = mipChain.GetWidth(int(level));
+			texture.height = mipChain.GetHeight(int(level));
 
-		SDL_assert(m_pSurface && "m_pSurface is nullptr!");
+			offsets[level] = numTexels;
+			if (layout == TexelLayout::Blocked)
+			{
+				//partial blocks at the right and bottom edge are padded, the padding is never sampled
+				texture.blocksPerRow = (texture.width + SIMD::TexelBlockSize - 1) / SIMD::TexelBlockSize;
+				const int blocksPerColumn{ (texture.height + SIMD::TexelBlockSize - 1) / SIMD::TexelBlockSize };
+				numTexels += size_t(texture.blocksPerRow) * size_t(blocksPerColumn) * (SIMD::TexelBlockSize * SIMD::TexelBlockSize);
+			}
+			else
+			{
+				numTexels += size_t(texture.width) * size_t(texture.height);
+			}
+		}
 
-		//sample
-		Uint32 u{ Uint32(tilesUv.x * m_pSurface->w) };
-		Uint32 v{ Uint32(tilesUv.y * m_pSurface->h) };
-		Uint32 pixel{ m_pSurfacePixels[u + (v * m_pSurface->w)] };
+		texels.assign(numTexels, 0);
+		for (size_t level{}; level < levels.size(); ++level)
+		{
+			SIMD::TextureTexels& texture{ levels[level] };
+			uint32_t* pTexels{ texels.data() + offsets[level] };
+			texture.pTexels = pTexels;
 
-		SDL_GetRGB(pixel, m_pSurface->format, &r, &g, &b);
+			const uint32_t* pSource{ mipChain.GetTexels(int(level)) };
+			for (int y{}; y < texture.height; ++y)
+			{
+				for (int x{}; x < texture.width; ++x)
+				{
+					pTexels[GetTexelIndex(texture, x, y)] = pSource[size_t(x) + size_t(y) * size_t(texture.width)];
+				}
+			}
+		}
+		return levels;
+	}
 
-		constexpr const float colorDivider{ 1.f / 255.f };
-		return { r * colorDivider, g * colorDivider, b * colorDivider };
+	void TextureSoftware::GetFootprint(const UVDerivatives& derivatives, float& lengthSquaredX, float& lengthSquaredY) const
+	{
+		const float width{ static_cast<float>(m_MipLevels[0].width) };
+		const float height{ static_cast<float>(m_MipLevels[0].height) };
+		lengthSquaredX = Square(derivatives.dUdX * width) + Square(derivatives.dVdX * height);
+		lengthSquaredY = Square(derivatives.dUdY * width) + Square(derivatives.dVdY * height);
 	}
 
-	ColorRGBA TextureSoftware::SampleRGBA(const Vector2& uv) const
+	float TextureSoftware::GetLevelOfDetail(float lengthSquared) const
 	{
-		Uint8 r{}, g{}, b{}, a{};
-		Vector2 tilesUv{ uv };
-		//tiling
-		//clamp to edge
-		if (tilesUv.x < 0.f)
-			tilesUv.x = 0.f;
-		else if (tilesUv.x > 1.f)
-			tilesUv.x = 1.f;
-		if (tilesUv.y < 0.f)
-			tilesUv.y = 0.f;
-		else if (tilesUv.y > 1.f)
-			tilesUv.y = 1.f;
-
-		//sample
-
-		Uint32 u{ Uint32(tilesUv.x * m_pSurface->w) };
-		Uint32 v{ Uint32(tilesUv.y * m_pSurface->h) };
-		Uint32 pixel{ m_pSurfacePixels[u + (v * m_pSurface->w)] };
-
-		SDL_GetRGBA(pixel, m_pSurface->format, &r, &g, &b, &a);
-
-		constexpr const float divider{ 1.f / 255.f };
-
-		return { r * divider, g * divider, b * divider, a * divider };
+		//magnified (or a broken footprint), the full resolution level is the closest
+		if (!(lengthSquared > 1.f))
+			return 0.f;
+
+		//0.5 * log2(length^2) = log2(length)
+		const float maxLevel{ static_cast<float>(m_MipLevels.size() - 1) };
+		return Min(0.5f * std::log2(lengthSquared), maxLevel);
 	}
 
 	//=======================//
@@ -92,10 +256,15 @@ namespace dae
 
 	TextureDX11::TextureDX11(SDL_Surface* pSurface, ID3D11Device* pDevice)
 	{
-		Init(pSurface, pDevice);
+		Init(pSurface, MipChain{ pSurface }, pDevice);
 		//SDL_FreeSurface(pSurface);
 	}
 
+	TextureDX11::TextureDX11(SDL_Surface* pSurface, const MipChain& mipChain, ID3D11Device* pDevice)
+	{
+		Init(pSurface, mipChain, pDevice);
+	}
+
 	TextureDX11::~TextureDX11()
 	{
 		m_pSRV->Release();
@@ -107,7 +276,7 @@ namespace dae
 		return new TextureDX11(IMG_Load(path.c_str()), pDevice);
 	}
 
-	void TextureDX11::Init(SDL_Surface* pSurface, ID3D11Device* pDevice)
+	void TextureDX11::Init(SDL_Surface* pSurface, const MipChain& mipChain, ID3D11Device* pDevice)
 	{
 		//=============================================================//
 		//				1. Create texture resource					   //
@@ -117,7 +286,7 @@ namespace dae
 
 		desc.Width = pSurface->w;
 		desc.Height = pSurface->h;
-		desc.MipLevels = 1;
+		desc.MipLevels = static_cast<UINT>(mipChain.GetNumLevels());
 		desc.ArraySize = 1;
 		desc.Format = format;
 		desc.SampleDesc.Count = 1;
@@ -127,12 +296,17 @@ namespace dae
 		desc.CPUAccessFlags = 0;
 		desc.MiscFlags = 0;
 
-		D3D11_SUBRESOURCE_DATA initData{};
-		initData.pSysMem = pSurface->pixels;
-		initData.SysMemPitch = static_cast<UINT>(pSurface->pitch);
-		initData.SysMemSlicePitch = static_cast<UINT>(pSurface->h * pSurface->pitch);
+		//one entry per mip level, the same levels the software rasterizer samples
+		std::vector<D3D11_SUBRESOURCE_DATA> initData(desc.MipLevels);
+		for (int level{}; level < mipChain.GetNumLevels(); ++level)
+		{
+			const UINT pitch{ static_cast<UINT>(mipChain.GetWidth(level) * sizeof(uint32_t)) };
+			initData[level].pSysMem = mipChain.GetTexels(level);
+			initData[level].SysMemPitch = pitch;
+			initData[level].SysMemSlicePitch = pitch * static_cast<UINT>(mipChain.GetHeight(level));
+		}
 
-		HRESULT result{ pDevice->CreateTexture2D(&desc, &initData, &m_pResource) };
+		HRESULT result{ pDevice->CreateTexture2D(&desc, initData.data(), &m_pResource) };
 		if (FAILED(result))
 			std::wcout << L"Creation of resource failed!\n";
 
@@ -142,7 +316,7 @@ namespace dae
 		D3D11_SHADER_RESOURCE_VIEW_DESC SRVDesc{};
 		SRVDesc.Format = format;
 		SRVDesc.ViewDimension = D3D11_SRV_DIMENSION_TEXTURE2D;
-		SRVDesc.Texture2D.MipLevels = 1;
+		SRVDesc.Texture2D.MipLevels = desc.MipLevels;
 
 		result = pDevice->CreateShaderResourceView(m_pResource, &SRVDesc, &m_pSRV);
 	}
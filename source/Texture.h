@@ -1,11 +1,70 @@
 #pragma once
 #include <SDL_surface.h>
 #include <string>
-#include "ColorRGB.h"
+#include <vector>
+#include "RasterizerSIMD.h"
 
 namespace dae
 {
-	struct Vector2;
+	//=======================//
+	// mip chain
+	//=======================//
+
+	// box filtered mip levels of a surface, built once at load time
+	// every level is in TexelFormat and tightly packed (pitch == width), level 0 is the surface converted to it
+	class MipChain final
+	{
+	public:
+		// the one texel format both rasterizers sample: bytes r, g, b, a in memory order (DXGI_FORMAT_R8G8B8A8_UNORM),
+		// so r is in the lowest 8 bits of a texel on the little endian targets
+		static constexpr Uint32 TexelFormat{ SDL_PIXELFORMAT_RGBA32 };
+
+		MipChain(const SDL_Surface* pSurface);
+		~MipChain() = default;
+
+		MipChain(const MipChain&) = delete;
+		MipChain(MipChain&&) noexcept = default;
+		MipChain& operator=(const MipChain&) = delete;
+		MipChain& operator=(MipChain&&) noexcept = default;
+
+		inline int GetNumLevels() const { return static_cast<int>(m_Levels.size()); }
+		inline const uint32_t* GetTexels(int level) const { return m_Texels.data() + m_Levels[level].offset; }
+		inline int GetWidth(int level) const { return m_Levels[level].width; }
+		inline int GetHeight(int level) const { return m_Levels[level].height; }
+
+	private:
+		struct Level
+		{
+			size_t offset{};
+			int width{};
+			int height{};
+		};
+
+		std::vector<uint32_t> m_Texels{};
+		std::vector<Level> m_Levels{};
+	};
+
+	// screenspace derivatives of the uvs a block is sampled at, in uv per pixel
+	struct UVDerivatives
+	{
+		float dUdX{}, dVdX{};
+		float dUdY{}, dVdY{};
+	};
+
+	// software version of the sampler states of the effects (gSamPoint, gSamLinear, gSamAnisotropic)
+	struct SamplerState
+	{
+		enum class Filter
+		{
+			Point, Linear, Anisotropic
+		};
+
+		Filter filter{ Filter::Point };
+		// clamp, the default texture address mode of the settings
+		SIMD::TextureAddress address{ SIMD::TextureAddress::Clamp };
+		// most taps along the longest axis of a pixel footprint, the effects leave MaxAnisotropy at its default
+		int maxAnisotropy{ 16 };
+	};
 
 	//=======================//
 	// software
@@ -14,29 +73,46 @@ namespace dae
 	class TextureSoftware
 	{
 	public:
-		TextureSoftware(SDL_Surface* pSurface);
-		~TextureSoftware();
-
-		TextureSoftware(TextureSoftware&& other) noexcept
-			: m_pSurface(std::move(other.m_pSurface))
-			, m_pSurfacePixels{ std::move(other.m_pSurfacePixels) }
+		// how the texels of every mip level are stored for the sampling kernel, see SIMD::TextureTexels
+		enum class TexelLayout
 		{
-		}
-		TextureSoftware& operator=(TextureSoftware&& other)
-		{
-			m_pSurface = std::move(other.m_pSurface);
-			m_pSurfacePixels = std::move(other.m_pSurfacePixels);
-			return *this;
-		}
+			Linear, Blocked
+		};
 
-		static TextureSoftware* LoadFromFile(const std::string& path);
-		ColorRGB Sample(const Vector2& uv) const;
-		ColorRGBA SampleRGBA(const Vector2& uv) const;
+		// copies the levels of mipChain in the blocked layout, the surface they came from isn't needed anymore
+		TextureSoftware(const MipChain& mipChain);
+		~TextureSoftware() = default;
 
-	private:
+		TextureSoftware(const TextureSoftware&) = delete;
+		TextureSoftware(TextureSoftware&&) noexcept = default;
+		TextureSoftware& operator=(const TextureSoftware&) = delete;
+		TextureSoftware& operator=(TextureSoftware&&) noexcept = default;
+
+		// samples a span with a sampler state, uvs in SoA layout
+		// the level of detail is picked once for the whole span from derivatives
+		// writes the first numChannels of r, g, b, a to pChannels, every lane is sampled
+		void SampleBlock(const float* pU, const float* pV, const UVDerivatives& derivatives, const SamplerState& sampler, int numChannels, float (*pChannels)[SIMD::MaxBlockWidth]) const;
 
-		SDL_Surface* m_pSurface{ nullptr };
-		uint32_t* m_pSurfacePixels{ nullptr };
+	private:
+		friend class TextureLayoutBenchmark;
+
+		// copies the levels of mipChain to texels in layout, returns what the sampling kernel needs of every level
+		static std::vector<SIMD::TextureTexels> CreateMipLevels(const MipChain& mipChain, TexelLayout layout, std::vector<uint32_t>& texels);
+		// scalar version of the addressing in SIMD::SampleTexels
+		static size_t GetTexelIndex(const SIMD::TextureTexels& texture, int x, int y);
+		// squared length of the x and y axis of the pixel footprint, in texels of level 0
+		void GetFootprint(const UVDerivatives& derivatives, float& lengthSquaredX, float& lengthSquaredY) const;
+		// mip level (with fraction) that has texels of about the size of a footprint axis with length^2 lengthSquared
+		float GetLevelOfDetail(float lengthSquared) const;
+		// bilinear on the two levels around levelOfDetail, adds weight * the result to pChannels
+		void SampleTrilinear(const float* pU, const float* pV, float levelOfDetail, SIMD::TextureAddress address, float weight, int numChannels, float (*pChannels)[SIMD::MaxBlockWidth]) const;
+		// trilinear taps spread over the longest axis of the footprint, level of detail from the shortest one
+		void SampleAnisotropic(const float* pU, const float* pV, const UVDerivatives& derivatives, const SamplerState& sampler, int numChannels, float (*pChannels)[SIMD::MaxBlockWidth]) const;
+
+		// every mip level in the blocked layout
+		std::vector<uint32_t> m_Texels{};
+		// one entry per mip level
+		std::vector<SIMD::TextureTexels> m_MipLevels{};
 	};
 
 	//=======================//
@@ -47,6 +123,8 @@ namespace dae
 	{
 	public:
 		TextureDX11(SDL_Surface* pSurface, ID3D11Device* pDevice);
+		// uploads every level of mipChain
+		TextureDX11(SDL_Surface* pSurface, const MipChain& mipChain, ID3D11Device* pDevice);
 		~TextureDX11();
 
 		TextureDX11(TextureDX11&& other) 
@@ -67,7 +145,7 @@ namespace dae
 
 	private:
 
-		void Init(SDL_Surface* pSurface, ID3D11Device* pDevice);
+		void Init(SDL_Surface* pSurface, const MipChain& mipChain, ID3D11Device* pDevice);
 
 		ID3D11Texture2D* m_pResource{ nullptr };
 		ID3D11ShaderResourceView* m_pSRV{ nullptr };
@@ -0,0 +1,149 @@
+#include "pch.h"
+#include "TextureLayoutBenchmark.h"
+#include "Texture.h"
+
+#include "ConsoleLog.h"
+
+#include <algorithm>
+#include <array>
+#include <chrono>
+
+namespace dae
+{
+	using namespace Log;
+
+	void TextureLayoutBenchmark::Run()
+	{
+		//noise, too big for any cache, only level 0 in both layouts
+		constexpr int textureSize{ 2048 };
+		static_assert(textureSize % SIMD::TexelBlockSize == 0);
+		std::vector<uint32_t> linearTexels(size_t(textureSize) * size_t(textureSize));
+		uint32_t state{ 1 };
+		for (uint32_t& texel : linearTexels)
+		{
+			state ^= state << 13;
+			state ^= state >> 17;
+			state ^= state << 5;
+			texel = state;
+		}
+
+		SIMD::TextureTexels textures[2]{};
+		textures[0] = { linearTexels.data(), textureSize, textureSize, 0 };
+		std::vector<uint32_t> blockedTexels(linearTexels.size());
+		textures[1] = { blockedTexels.data(), textureSize, textureSize, textureSize / SIMD::TexelBlockSize };
+		for (int y{}; y < textureSize; ++y)
+		{
+			for (int x{}; x < textureSize; ++x)
+			{
+				blockedTexels[TextureSoftware::GetTexelIndex(textures[1], x, y)] = linearTexels[size_t(x) + size_t(y) * size_t(textureSize)];
+			}
+		}
+
+		//a square of pixels mapped on level 0, rotated by angle degrees with scale texels per pixel
+		//nearest mip selection keeps the real footprint below ~1.4 texels per pixel
+		constexpr int numPixelsX{ 256 };
+		constexpr int numRepeats{ 16 };
+		struct Pattern
+		{
+			float angle{};
+			float scale{};
+		};
+		constexpr Pattern patterns[]{ { 0.f, 1.f }, { 0.f, 2.f }, { 45.f, 1.f }, { 45.f, 2.f }, { 90.f, 1.f }, { 90.f, 2.f } };
+
+		//64 sets of 8 lines of 64 bytes, a typical 32 KiB L1 data cache with lru replacement
+		constexpr size_t numSets{ 64 };
+		constexpr size_t numWays{ 8 };
+		constexpr size_t lineSize{ 64 };
+
+		TSTRING msg{ _T("Texture layout benchmark (") + TO_TSTRING(textureSize) + _T("x") + TO_TSTRING(textureSize)
+			+ _T(" texels, ") + TO_TSTRING(numPixelsX) + _T("x") + TO_TSTRING(numPixelsX) + _T(" pixels, 32 KiB cache model)") };
+		const int blockWidth{ SIMD::GetBlockWidth() };
+		//keeps the samples alive
+		volatile float sink{};
+		for (const Pattern& pattern : patterns)
+		{
+			const float radians{ pattern.angle * TO_RADIANS };
+			const float stepU{ cosf(radians) * pattern.scale / textureSize };
+			const float stepV{ sinf(radians) * pattern.scale / textureSize };
+
+			msg.append(_T("\n	") + TO_TSTRING(int(pattern.angle)) + _T(" deg, ") + TO_TSTRING(int(pattern.scale)) + _T(" texels/pixel :"));
+			//uvs of the span at (px, py), centered on the texture
+			alignas(32) float u[SIMD::MaxBlockWidth]{};
+			alignas(32) float v[SIMD::MaxBlockWidth]{};
+			const auto setSpanUVs = [&](int px, int py)
+				{
+					for (int i{}; i < blockWidth; ++i)
+					{
+						const float x{ float(px + i - numPixelsX / 2) };
+						const float y{ float(py - numPixelsX / 2) };
+						u[i] = 0.5f + x * stepU - y * stepV;
+						v[i] = 0.5f + x * stepV + y * stepU;
+					}
+				};
+
+			for (const SIMD::TextureTexels& texture : textures)
+			{
+				//cache model, one untimed pass
+				std::array<uint64_t, numSets * numWays> lines{};
+				std::array<uint32_t, numSets * numWays> lastUse{};
+				uint32_t time{};
+				size_t numHits{}, numSamples{};
+				for (int py{}; py < numPixelsX; ++py)
+				{
+					for (int px{}; px < numPixelsX; px += blockWidth)
+					{
+						setSpanUVs(px, py);
+						for (int i{}; i < blockWidth; ++i)
+						{
+							const int x{ Min(int(Saturate(u[i]) * texture.width), texture.width - 1) };
+							const int y{ Min(int(Saturate(v[i]) * texture.height), texture.height - 1) };
+							const uint64_t line{ TextureSoftware::GetTexelIndex(texture, x, y) * sizeof(uint32_t) / lineSize };
+							const size_t set{ size_t(line % numSets) * numWays };
+
+							size_t way{};
+							while (way < numWays && lines[set + way] != line + 1)
+								++way;
+							if (way < numWays)
+							{
+								++numHits;
+							}
+							else
+							{
+								//miss, replace the least recently used line of the set
+								way = size_t(std::min_element(lastUse.begin() + set, lastUse.begin() + set + numWays) - (lastUse.begin() + set));
+								lines[set + way] = line + 1;
+							}
+							lastUse[set + way] = ++time;
+							++numSamples;
+						}
+					}
+				}
+
+				//only the sampling is timed
+				alignas(32) float channels[4][SIMD::MaxBlockWidth]{};
+				const auto start{ std::chrono::steady_clock::now() };
+				for (int repeat{}; repeat < numRepeats; ++repeat)
+				{
+					for (int py{}; py < numPixelsX; ++py)
+					{
+						for (int px{}; px < numPixelsX; px += blockWidth)
+						{
+							setSpanUVs(px, py);
+							SIMD::SampleTexels(texture, SIMD::TextureAddress::Clamp, u, v, 4, channels);
+							sink = sink + channels[0][0];
+						}
+					}
+				}
+				const auto end{ std::chrono::steady_clock::now() };
+
+				//time in hundredths of a nanosecond
+				const int time100{ int(std::chrono::duration<double, std::nano>(end - start).count() * 100.0 / (double(numRepeats) * numPixelsX * numPixelsX) + 0.5) };
+				const int hitRate{ int(100.0 * double(numHits) / double(numSamples) + 0.5) };
+				msg.append((texture.blocksPerRow == 0) ? _T(" linear ") : _T(" | blocked "));
+				msg.append(TO_TSTRING(time100 / 100) + _T(".") + TO_TSTRING(time100 % 100 / 10) + TO_TSTRING(time100 % 10)
+					+ _T(" ns ") + TO_TSTRING(hitRate) + _T("% hits"));
+			}
+		}
+		PrintMessage(msg, MSG_LOGGER_SOFTWARERASTERIZER, MSG_COLOR_SOFTWARERASTERIZER);
+	}
+}
@@ -0,0 +1,13 @@
+#pragma once
+
+namespace dae
+{
+	// development tool behind the [B] key, compares the texel layouts of TextureSoftware
+	// samples a synthetic texture along rotated and minified spans in the linear and the blocked layout
+	// prints the time per sample and the hit rate of a simulated L1 cache
+	class TextureLayoutBenchmark final
+	{
+	public:
+		static void Run();
+	};
+}
@@ -0,0 +1,93 @@
+#include "pch.h"
+#include "ThreadPool.h"
+
+namespace dae
+{
+	ThreadPool::ThreadPool()
+		// hardware_concurrency() can report 0
+		: ThreadPool(Max(std::thread::hardware_concurrency(), 1u) - 1)
+	{
+	}
+
+	ThreadPool::ThreadPool(size_t numWorkers)
+	{
+		m_Workers.reserve(numWorkers);
+		for (size_t i{}; i < numWorkers; ++i)
+		{
+			m_Workers.emplace_back(&ThreadPool::WorkerLoop, this);
+		}
+	}
+
+	ThreadPool::~ThreadPool()
+	{
+		{
+			std::lock_guard<std::mutex> lock{ m_Mutex };
+			m_IsStopping = true;
+		}
+		m_WakeCondition.notify_all();
+
+		for (auto& worker : m_Workers)
+		{
+			worker.join();
+		}
+	}
+
+	void ThreadPool::ParallelFor(size_t count, const std::function<void(size_t)>& job)
+	{
+		if (count == 0)
+			return;
+
+		{
+			std::lock_guard<std::mutex> lock{ m_Mutex };
+			m_pJob = &job;
+			m_JobCount = count;
+			m_NextJob = 0;
+			m_ActiveWorkers = m_Workers.size();
+			++m_Generation;
+		}
+		m_WakeCondition.notify_all();
+
+		// the calling thread helps out instead of idling
+		RunJobs();
+
+		std::unique_lock<std::mutex> lock{ m_Mutex };
+		m_DoneCondition.wait(lock, [this]() { return m_ActiveWorkers == 0; });
+		m_pJob = nullptr;
+	}
+
+	void ThreadPool::WorkerLoop()
+	{
+		size_t generation{};
+
+		while (true)
+		{
+			{
+				std::unique_lock<std::mutex> lock{ m_Mutex };
+				m_WakeCondition.wait(lock, [this, generation]() { return m_IsStopping || m_Generation != generation; });
+
+				if (m_IsStopping)
+					return;
+
+				generation = m_Generation;
+			}
+
+			RunJobs();
+
+			{
+				std::lock_guard<std::mutex> lock{ m_Mutex };
+				if (--m_ActiveWorkers == 0)
+					m_DoneCondition.notify_one();
+			}
+		}
+	}
+
+	void ThreadPool::RunJobs()
+	{
+		size_t jobIdx{ m_NextJob.fetch_add(1) };
+		while (jobIdx < m_JobCount)
+		{
+			(*m_pJob)(jobIdx);
+			jobIdx = m_NextJob.fetch_add(1);
+		}
+	}
+}
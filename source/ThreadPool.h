@@ -0,0 +1,47 @@
+#pragma once
+#include <functional>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include <atomic>
+
+namespace dae
+{
+	class ThreadPool final
+	{
+	public:
+		// one worker per hardware thread, minus the calling thread
+		ThreadPool();
+		// numWorkers excludes the calling thread, which also executes jobs
+		explicit ThreadPool(size_t numWorkers);
+		~ThreadPool();
+
+		ThreadPool(const ThreadPool&) = delete;
+		ThreadPool(ThreadPool&&) noexcept = delete;
+		ThreadPool& operator=(const ThreadPool&) = delete;
+		ThreadPool& operator=(ThreadPool&&) noexcept = delete;
+
+		// runs job(0) .. job(count - 1) spread over all workers + the calling thread
+		// returns once every job has finished
+		void ParallelFor(size_t count, const std::function<void(size_t)>& job);
+
+		inline size_t GetNumThreads() const { return m_Workers.size() + 1; }
+
+	private:
+		void WorkerLoop();
+		void RunJobs();
+
+		std::vector<std::thread> m_Workers;
+
+		std::mutex m_Mutex;
+		std::condition_variable m_WakeCondition;
+		std::condition_variable m_DoneCondition;
+
+		const std::function<void(size_t)>* m_pJob{ nullptr };
+		size_t m_JobCount{};
+		std::atomic<size_t> m_NextJob{};
+		size_t m_ActiveWorkers{};
+		size_t m_Generation{};
+		bool m_IsStopping{ false };
+	};
+}
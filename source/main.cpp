@@ -164,22 +164,24 @@ void PrintKeyBindings()
 	sharedMsg.append(_T("	[F1]	Toggle Rasterizer Mode - (HARDWARE/SOFTWARE)\n"));
 	sharedMsg.append(_T("	[F2]	Toggle Vehicle Rotation - (ON/OFF)\n"));
 	sharedMsg.append(_T("	[F3]	Toggle FireFX - (ON/OFF)\n"));
+	sharedMsg.append(_T("	[F4]	Cycle Sampler State - (POINT/LINEAR/ANISOTROPIC)\n"));
 	sharedMsg.append(_T("	[F9]	Cycle CullMode - (BACKFACE/FRONTFACE/NONE)\n"));
 	sharedMsg.append(_T("	[F10]	Toggle Uniform Clear Color - (ON/OFF)\n"));
 	sharedMsg.append(_T("	[F11]	Toggle Print FPS - (ON/OFF)"));
 	PrintMessage(sharedMsg, MSG_LOGGER_SHARED, MSG_COLOR_RENDERER, COLOR_GRAY);
 
-	TSTRING hardwareMsg{};
-	hardwareMsg.append(_T("[Key Bindings]\n"));
-	hardwareMsg.append(_T("	[F4]	Cycle Sampler State - (POINT/LINEAR/ANISOTROPIC)"));
-	PrintMessage(hardwareMsg, MSG_LOGGER_HARDWARERASTERIZER, MSG_COLOR_HARDWARERASTERIZER, COLOR_GRAY);
-
 	TSTRING softwareMsg{};
 	softwareMsg.append(_T("[Key Bindings]\n"));
 	softwareMsg.append(_T("	[F5]	Cycle Shading Mode - (COMBINED/OBSERVED_AREA/DIFFUSE/SPECULAR)\n"));
 	softwareMsg.append(_T("	[F6]	Toggle Normal Map - (ON/OFF)\n"));
 	softwareMsg.append(_T("	[F7]	Toggle DepthBuffer Visualization - (ON/OFF)\n"));
-	softwareMsg.append(_T("	[F8]	Toggle BoundingBox Visualization - (ON/OFF)"));
+	softwareMsg.append(_T("	[F8]	Toggle BoundingBox Visualization - (ON/OFF)\n"));
+	softwareMsg.append(_T("	[F12]	Print Triangle Stats\n"));
+	softwareMsg.append(_T("	[P]	Cycle Shading Path - (FORWARD/VISIBILITY_BUFFER/DEPTH_PREPASS)\n"));
+	softwareMsg.append(_T("	[K]	Cycle SIMD Kernels - (AUTO/SSE2/AVX2/AVX512)\n"));
+	softwareMsg.append(_T("	[L]	Toggle Tiled Framebuffer - (ON/OFF)\n"));
+	softwareMsg.append(_T("	[B]	Run Texture Layout Benchmark\n"));
+	softwareMsg.append(_T("	[T]	Cycle Texture Address Mode - (WRAP/CLAMP/MIRROR)"));
 	PrintMessage(softwareMsg, MSG_LOGGER_SOFTWARERASTERIZER, MSG_COLOR_SOFTWARERASTERIZER, COLOR_GRAY);
 
 	PrintTstring(_T(""), _T("[Extra Features]"), MSG_COLOR_RENDERER);